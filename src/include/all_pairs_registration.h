@@ -0,0 +1,129 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "nfrl_lib.h"
+#include "registration_batch.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+#ifdef USE_OPENCV
+  namespace NFRL {
+#else
+  namespace NFRL_ITL {
+#endif
+
+/**
+ * @brief Registers pairs drawn from one set of images, e.g., every
+ *  impression of a subject against every other one, preparing each image
+ *  once rather than once per pair.
+ *
+ * Each image is decoded and prepared (see Registrator::PreparedImage)
+ * when first needed and shared, as the Moving or the Fixed image, by every
+ * pair that uses it while it stays resident.  The pair matrix (Moving by
+ * Fixed) is cut into square blocks of blockSize() images per side, run one
+ * block at a time on the workers of a RegistrationBatch; the blocks are
+ * visited row by row, alternating direction, so consecutive blocks share
+ * their Moving images and one side of Fixed images.
+ *
+ * The memory budget bounds the bytes of the resident prepared images: the
+ * block size is chosen so that the images of one block fit within it, and
+ * the least recently used images not needed by the next block are released
+ * to make room.  The images are sized by the first image of a valid pair,
+ * Moving or Fixed, that can be prepared (the images of a set are alike); the
+ * block is never below one image per side.  If every image fits, each is
+ * prepared exactly once.
+ *
+ * The results are returned in the order of the pairs.
+ */
+class AllPairsRegistration
+{
+public:
+  /** @brief One image of the set: an encoded byte-stream, or a file. */
+  struct Image
+  {
+    /** @brief Encoded image; read from path if null. */
+    Registrator::SharedBuffer buffer;
+    /** @brief File of the image, when not given as a byte-stream. */
+    std::string path;
+  };
+
+  /** @brief One registration: indices of two images of the set. */
+  struct Pair
+  {
+    /** @brief Index of the Moving image. */
+    int moving{0};
+    /** @brief Index of the Fixed image. */
+    int fixed{0};
+    /** @brief 8 coordinates of the corresponding points, see Registrator. */
+    std::vector<int> correspondingPoints;
+    /** @brief OutputArtifact bits of the outputs to return. */
+    unsigned int outputs{Registrator::allOutputs};
+  };
+
+private:
+  /** @brief Registers the pairs of each block. */
+  RegistrationBatch _batch;
+  /** @brief Bytes of prepared images that may stay resident. */
+  size_t _memoryBudget{0};
+  /** @brief Images per side of a block of the last run. */
+  int _blockSize{0};
+  /** @brief Blocks of the last run that held pairs. */
+  int _blockCount{0};
+  /** @brief Images prepared by the last run, counting re-preparations. */
+  int _preparedCount{0};
+  /** @brief Most bytes of prepared images resident during the last run. */
+  size_t _peakBytes{0};
+
+public:
+
+  void Init();
+
+  // Default constructor.
+  AllPairsRegistration();
+
+  // Full constructor.
+  AllPairsRegistration( const Registrator::RegistrationOptions&,
+                        const size_t, const int = 0, const int = 1 );
+  ~AllPairsRegistration() {}
+
+  std::vector<RegistrationBatch::Result> run( const std::vector<Image>&,
+                                              const std::vector<Pair>& );
+
+  /** @brief Images per side of a block of the last run. */
+  int blockSize() const { return _blockSize; }
+  /** @brief Images prepared by the last run, counting re-preparations. */
+  int preparedCount() const { return _preparedCount; }
+
+  std::string to_s() const;
+};
+
+}   // END namespace
@@ -0,0 +1,97 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+namespace NFRL {
+
+/**
+ * @brief A binary image stored as one bit per pixel.
+ *
+ * Each row is a whole number of 64-bit words; bit j of word w is the pixel
+ * at column 64*w + j.  Bits past the last column are always clear, so the
+ * word-parallel operations need no per-pixel masking.  This is one eighth of
+ * the memory of an 8-bit binary image.
+ */
+class BinaryImage
+{
+private:
+  /** @brief Width and height in pixels. */
+  cv::Size _size;
+  /** @brief Number of words per row. */
+  int _wordsPerRow{0};
+  /** @brief Row-major words, _wordsPerRow per row. */
+  std::vector<uint64_t> _words;
+
+  uint64_t lastWordMask() const;
+
+public:
+
+  void Init();
+
+  // Default constructor.
+  BinaryImage();
+
+  // Full constructor.
+  BinaryImage( const cv::Size&, const bool = false );
+  ~BinaryImage() {}
+
+  static BinaryImage fromAtMost( const cv::Mat&, const int );
+
+  /** @brief Width and height in pixels. */
+  cv::Size size() const { return _size; }
+  /** @brief True if there are no pixels. */
+  bool empty() const { return _size.area() == 0; }
+  /** @brief Number of 64-bit words per row. */
+  int wordsPerRow() const { return _wordsPerRow; }
+  /** @brief Words of row y. */
+  uint64_t* row( int y ) { return &_words[ static_cast<size_t>( y ) * _wordsPerRow ]; }
+  /** @brief Words of row y. */
+  const uint64_t* row( int y ) const { return &_words[ static_cast<size_t>( y ) * _wordsPerRow ]; }
+
+  bool at( int, int ) const;
+  void orRow( int, int, const uint64_t*, int );
+
+  BinaryImage& operator&=( const BinaryImage& );
+  BinaryImage& operator|=( const BinaryImage& );
+  BinaryImage operator~() const;
+
+  BinaryImage dilate3x3() const;
+  BinaryImage dilate( const int ) const;
+
+  bool rowExtent( int, int&, int& ) const;
+  cv::Rect boundingRect() const;
+  cv::Rect boundingRect( const cv::Rect& ) const;
+
+  cv::Mat toMat( const uint8_t = 255, const uint8_t = 0 ) const;
+};
+
+}   // End namespace
@@ -74,16 +74,21 @@ private:
    *   by the caller. */
   std::vector<std::string> &_metadata;
 
+  static NFRL::Registrator::RawPixels sharePixels( const cv::Mat& );
+  cv::Mat outputImage( NFRL::Registrator::OutputArtifact );
+
 public:
   // Default constructor.
   Registrator();
 
   /** @brief Full constructor used by NFRL with OpenCV API. */
   Registrator( cv::Mat &, cv::Mat &,
-               std::vector<int> &, std::vector<std::string> & );
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int outputs = NFRL::Registrator::allOutputs );
   virtual ~Registrator() {}   // smart-pointer precludes delete _r2; call
 
   void performRegistration();
+  void performRegistration( const NFRL::Registrator::RegistrationOptions& );
 
   void getMetadata( NFRL::Registrator::RegistrationMetadata& );
   void getXmlMetadata( XmlMetadata& );
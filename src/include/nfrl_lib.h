@@ -29,7 +29,9 @@ identified are necessarily the best available for the purpose.
 
 #include "exceptions.h"
 
+#include <array>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -47,6 +49,10 @@ typedef std::vector<std::string> XmlMetadata;
 #define NFRL_VERSION "0.1.0"
 
 
+#ifdef USE_OPENCV
+  namespace NFRL_ITL { class Registrator; }
+#endif
+
 #ifdef USE_OPENCV
   /**
    * @brief Implements the NFRL "core" library that takes image data as
@@ -70,11 +76,37 @@ std::string printVersion();
  */
 class Registrator
 {
+#ifdef USE_OPENCV
+  /** @brief The OpenCV wrapper shares its cv::Mat pixels, in and out. */
+  friend class NFRL_ITL::Registrator;
+#endif
+
+public:
+  /** @brief Immutable byte-stream of an encoded image, shared with the
+   *   caller. */
+  typedef std::shared_ptr<const std::vector<uint8_t>> SharedBuffer;
+
 private:
   /** @brief Byte-stream of the Moving image. */
-  std::vector<uint8_t> _imgMoving;
+  SharedBuffer _imgMoving;
   /** @brief Byte-stream of the Fixed image. */
-  std::vector<uint8_t> _imgFixed;
+  SharedBuffer _imgFixed;
+
+  /** @brief Decoded, 8-bit pixels of an input image.
+   *
+   * The pointer owns (or keeps alive) the pixels; they are never modified. */
+  struct RawPixels
+  {
+    std::shared_ptr<const uint8_t> data;
+    int width{0};
+    int height{0};
+    size_t stride{0};
+    int channels{0};
+  };
+  /** @brief Pixels of the Moving image, when not given as a byte-stream. */
+  RawPixels _rawMoving;
+  /** @brief Pixels of the Fixed image, when not given as a byte-stream. */
+  RawPixels _rawFixed;
 
   /** @brief 8 individual coordinates of the two registration pairs of points.
    *
@@ -108,7 +140,19 @@ private:
   /** @brief Byte-stream of blob of overlay region only. */
   std::vector<uint8_t> _vecPngBlob;
 
-  /** @brief Supports padding of source images prior to registration. */
+  /** @brief Padded images retained by the last registration, defined in
+   *   registrator_imagery.h to keep OpenCV out of this header. */
+  struct Imagery;
+  std::unique_ptr<Imagery> _imagery;
+
+  /** @brief OutputArtifact bits of the outputs the caller will retrieve. */
+  unsigned int _outputs{allOutputs};
+
+  /** @brief Supports padding of source images prior to registration.
+   *
+   * For the tight-canvas padding policy, the canvas may be smaller than the
+   * unregistered Moving image; its bottom and right values are then negative.
+   */
   struct PaddingDifferential
   {
     /** @brief Margin from top of source image to padded edge. */
@@ -176,6 +220,260 @@ private:
 
 
 public:
+  /** @brief How the translation and rotation are applied to the Moving image. */
+  enum TransformMode
+  {
+    /** Translate onto an interim canvas (a whole-pixel placement), then
+     *  rotate the translated image (default). */
+    sequential = 1,
+    /** Rotation matrix times translation matrix, applied in one resample. */
+    composed
+  };
+
+  /** @brief Resampling method used to warp the Moving image. */
+  enum Interpolation
+  {
+    /** Nearest neighbor. */
+    nearest = 1,
+    /** Bilinear (default). */
+    linear,
+    /** Bicubic. */
+    cubic
+  };
+
+  /** @brief Resampler used to warp the Moving image. */
+  enum WarpKernel
+  {
+    /** OpenCV warpAffine() (default). */
+    opencvWarp = 1,
+    /** NFRL's fixed-point resampler: identical pixels on every CPU, OpenCV
+     *  version and thread count; nearest and bilinear interpolation. */
+    fixedPointWarp
+  };
+
+  /** @brief How the size of the padded canvas is determined. */
+  enum PaddingPolicy
+  {
+    /** (W2 + 2*W1) x (H2 + 2*H1), the Fixed image centered (default). */
+    legacyCanvas = 1,
+    /** Bounding box of the Fixed image and the registered Moving image
+     *  (and the translated Moving image for the two-step warp). */
+    tightCanvas
+  };
+
+  /**
+   * @brief Registration outputs, combined as a bit mask to select the outputs
+   *  that are retained for retrieval.
+   *
+   * Each selected output is generated and encoded on its first retrieval;
+   * outputs not selected are neither generated nor retained.
+   */
+  enum OutputArtifact
+  {
+    /** Cropped, registered Moving image. */
+    croppedRegisteredImage = 1,
+    /** Cropped Fixed image. */
+    croppedFixedImage = 2,
+    /** Padded, colorized, overlaid, registered images. */
+    colorOverlaidImage = 4,
+    /** Padded Fixed image, grayscale. */
+    paddedFixedImage = 8,
+    /** Padded, registered Moving image, grayscale. */
+    paddedRegisteredMovingImage = 16,
+    /** Blob from which the ROI is calculated. */
+    overlapBlob = 32,
+    /** All of the above (default). */
+    allOutputs = 63
+  };
+
+  /** @brief Encoding of an output byte-stream. */
+  enum ImageFormat
+  {
+    /** PNG, lossless and compressed (default). */
+    pngFormat = 1,
+    /** Binary PGM (grayscale) or PPM (color): a short text header and the
+     *  uncompressed rows; the fastest to encode. */
+    pnmFormat,
+    /** Uncompressed BMP. */
+    bmpFormat
+  };
+
+  /** @brief zlib strategy of the PNG encoder. */
+  enum PngStrategy
+  {
+    /** The encoder's default: OpenCV's, run-length matches (default). */
+    defaultStrategy = 1,
+    /** For filtered, photographic data. */
+    filteredStrategy,
+    /** Huffman coding only, no string matching; fast. */
+    huffmanOnlyStrategy,
+    /** Run-length matches only; fast, and suits the binary blob. */
+    rleStrategy,
+    /** Fixed Huffman codes. */
+    fixedStrategy,
+    /** zlib default: string matching and Huffman coding. */
+    zlibDefaultStrategy
+  };
+
+  /** @brief Row filter of the PNG encoder.  Honored by OpenCV 4.11 and
+   *   later; earlier versions choose the filter themselves. */
+  enum PngFilter
+  {
+    /** Chosen by the encoder (default). */
+    defaultFilter = 1,
+    /** No filter; fastest. */
+    noFilter,
+    /** Difference from the pixel to the left. */
+    subFilter,
+    /** Difference from the pixel above. */
+    upFilter,
+    /** Difference from the mean of the left and upper pixels. */
+    averageFilter,
+    /** Paeth predictor. */
+    paethFilter,
+    /** Best of all filters per row; slowest. */
+    allFilters
+  };
+
+  /** @brief Encoder settings of an output byte-stream. */
+  struct EncoderSettings
+  {
+    ImageFormat format{pngFormat};
+    /** @brief PNG zlib level, 0 (store) to 9 (smallest); -1 for OpenCV's
+     *   default. */
+    int pngLevel{-1};
+    PngStrategy pngStrategy{defaultStrategy};
+    PngFilter pngFilter{defaultFilter};
+    /** @brief Encode the PNG with NFRL's strip encoder, filtered and deflated
+     *   in strips of rows on RegistrationOptions::threads threads (see
+     *   StripPngEncoder); it decodes to the same pixels as OpenCV's PNG,
+     *   and its bytes do not depend on the thread count. */
+    bool parallelPng{false};
+    /** @brief Encode the PNG of the blob, a binary (0 or 255) image, as a
+     *   1-bit PNG; it decodes to the same pixels.  Ignored for the other
+     *   outputs. */
+    bool pngBilevel{false};
+
+    std::string to_s() const;
+  };
+
+  /**
+   * @brief Non-owning view of 8-bit pixels.
+   *
+   * Rows are `stride` bytes apart; pixels are 1 (grayscale), 3 (BGR), or
+   * 4 (BGRA) channels.  For an output image, the pixels are owned by the
+   * Registrator and remain valid until the next registration or the
+   * destruction of the Registrator.  For an input image, the pixels are
+   * owned by the caller and are copied by the Registrator constructor.
+   */
+  struct ImageView
+  {
+    const uint8_t *data{nullptr};
+    int width{0};
+    int height{0};
+    size_t stride{0};
+    int channels{0};
+
+    bool empty() const { return data == nullptr; }
+  };
+
+  /**
+   * @brief Per-call configuration of the registration process.
+   *
+   * Default values reproduce the original NFRL registration exactly.
+   */
+  struct RegistrationOptions
+  {
+    /** @brief Two steps or a single, composed warp. */
+    TransformMode transformMode{sequential};
+    /** @brief Resampling method for every warp of the Moving image. */
+    Interpolation interpolation{linear};
+    /** @brief Size of the canvas both images are padded to. */
+    PaddingPolicy paddingPolicy{legacyCanvas};
+    /** @brief Represent padding by offsets instead of storing padding pixels;
+     *   padded images are materialized only when requested. */
+    bool virtualPadding{false};
+    /** @brief Produce only the cropped images: implies virtual padding, and
+     *   limits the selected outputs to the cropped images. */
+    bool croppedOutputsOnly{false};
+    /** @brief Encode the color overlay as an 8-bit palette PNG, 16 levels of
+     *   each image, instead of a 24-bit PNG; for visual inspection. */
+    bool paletteOverlay{false};
+    /** @brief Warp, threshold and overlap the images in cache-sized tiles on
+     *   all threads (see TiledEngine); implies virtual padding. */
+    bool tiledEngine{false};
+    /** @brief Tile width and height in pixels for the tiled engine. */
+    int tileSize{256};
+    /** @brief Resampler of the Moving image; the fixed-point resampler
+     *   implies virtual padding. */
+    WarpKernel warpKernel{opencvWarp};
+    /** @brief Search the overlap ROI coarse-to-fine over blocks of this many
+     *   pixels per side, e.g., 4 or 8; 0 searches at full resolution.  The
+     *   ROI is the same.  Not used by the tiled engine. */
+    int roiCoarseFactor{0};
+    /** @brief Trim the light margins of both sources to their foreground
+     *   before they are placed on the canvas; the canvas and every reported
+     *   coordinate are those of the whole images. */
+    bool trimSourceMargins{false};
+    /** @brief Encoder settings per output; outputs not listed are encoded
+     *   as 8-bit PNG with OpenCV's defaults (the blob as a 1-bit PNG only
+     *   if EncoderSettings::pngBilevel is set for it).  The palette overlay
+     *   is only encoded as PNG. */
+    std::map<OutputArtifact, EncoderSettings> encoders;
+    /** @brief Threads for the independent stages of one registration and
+     *   for encodeSelectedOutputs(); 1 runs every stage in order on the
+     *   calling thread, 0 uses all hardware threads.  OpenCV's own parallel
+     *   loops are not limited by this. */
+    int threads{1};
+  };
+
+  /**
+   * @brief An image prepared once for registering it many times, as the
+   *  Fixed image of many Moving images, or as either image of many pairs.
+   *
+   * The image is decoded (or converted to grayscale) once, and the work of
+   * one side of a registration that does not depend on the other image is
+   * done once: the histogram for its Otsu threshold and its foreground (see
+   * RegistrationOptions::trimSourceMargins), with the histogram of the
+   * foreground.  As the Moving image, its pixels and foreground are used
+   * (see AllPairsRegistration).  The prepared image is immutable, so any
+   * number of Registrators, in any number of threads, may share it.
+   */
+  class PreparedImage
+  {
+    friend class Registrator;
+
+    /** @brief Grayscale pixels. */
+    RawPixels _pixels;
+    /** @brief The source image was converted to grayscale. */
+    bool _converted{false};
+    /** @brief Count of pixels per value. */
+    std::array<uint64_t, 256> _histogram{};
+    /** @brief Foreground rectangle: x, y, width and height. */
+    std::array<int, 4> _foreground{};
+    /** @brief Count of pixels per value within the foreground. */
+    std::array<uint64_t, 256> _foregroundHistogram{};
+
+    void prepare();
+
+  public:
+    // Full constructor for an encoded image.
+    PreparedImage( const SharedBuffer& );
+    // Full constructor for 8-bit pixels, which are copied.
+    PreparedImage( const ImageView& );
+    ~PreparedImage() {}
+
+    /** @brief Width of the image. */
+    int width() const { return _pixels.width; }
+    /** @brief Height of the image. */
+    int height() const { return _pixels.height; }
+    /** @brief Bytes held by the prepared image. */
+    size_t byteSize() const
+    {
+      return sizeof( *this ) + _pixels.stride * _pixels.height;
+    }
+  };
+
   /**
    * @brief This struct is used to capture registration metadata calculated
    *  each time a pair of images is registered.
@@ -357,8 +655,34 @@ public:
    * images where the registration points are corresponding control points as
    * determined by the caller. */
   Registrator( std::vector<uint8_t>, std::vector<uint8_t>,
-               std::vector<int> &, std::vector<std::string> & );
-  virtual ~Registrator() {}
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int outputs = allOutputs );
+
+  /** @brief Full constructor for byte-streams shared with the caller; the
+   *   byte-streams are not copied. */
+  Registrator( SharedBuffer, SharedBuffer,
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int outputs = allOutputs );
+
+  /** @brief Full constructor for decoded, 8-bit pixels; no image decoding
+   *   is performed by the registration. */
+  Registrator( const ImageView&, const ImageView&,
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int outputs = allOutputs );
+
+  /** @brief Full constructor against a prepared Fixed image, shared with
+   *   other Registrators; its Fixed-side work is not repeated. */
+  Registrator( SharedBuffer, std::shared_ptr<const PreparedImage>,
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int outputs = allOutputs );
+
+  /** @brief Full constructor for a prepared Moving and a prepared Fixed
+   *   image; neither is decoded by the registration. */
+  Registrator( std::shared_ptr<const PreparedImage>,
+               std::shared_ptr<const PreparedImage>,
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int outputs = allOutputs );
+  virtual ~Registrator();
 
   /** @brief Call this function to register two images.
    *
@@ -366,12 +690,31 @@ public:
    * initialized in full constructor. */
   void performRegistration();
 
-  std::vector<uint8_t> getColorOverlaidRegisteredImages();
-  std::vector<uint8_t> getCroppedRegisteredImage();
-  std::vector<uint8_t> getCroppedFixedImage();
-  std::vector<uint8_t> getPaddedFixedImg();
-  std::vector<uint8_t> getPaddedRegisteredMovingImg();
-  std::vector<uint8_t> getPngBlob();
+  // Register two images per the caller's options.
+  void performRegistration( const RegistrationOptions& );
+
+  const std::vector<uint8_t>& getColorOverlaidRegisteredImages();
+  const std::vector<uint8_t>& getCroppedRegisteredImage();
+  const std::vector<uint8_t>& getCroppedFixedImage();
+  const std::vector<uint8_t>& getPaddedFixedImg();
+  const std::vector<uint8_t>& getPaddedRegisteredMovingImg();
+  const std::vector<uint8_t>& getPngBlob();
+
+  // Encode the selected outputs concurrently, ahead of the getters.
+  void encodeSelectedOutputs();
+
+  // Move the byte-stream out of this object.
+  std::vector<uint8_t> releaseColorOverlaidRegisteredImages();
+  std::vector<uint8_t> releaseCroppedRegisteredImage();
+  std::vector<uint8_t> releaseCroppedFixedImage();
+  std::vector<uint8_t> releasePaddedFixedImg();
+  std::vector<uint8_t> releasePaddedRegisteredMovingImg();
+  std::vector<uint8_t> releasePngBlob();
+
+  // Raw pixels of an output image, no encoding.
+  ImageView getImageView( OutputArtifact );
+  // Bytes to hold an output image with rows packed.
+  size_t getImageByteSize( OutputArtifact ) const;
 
 
   // Get by reference.
@@ -408,6 +751,23 @@ private:
   void buildXmlTagline( XmlMetadata&, std::string );
   void buildXmlTagline( XmlMetadata&, std::string, std::string );
 
+  int interpolationFlag( Interpolation ) const;
+  static void copyRawPixels( const ImageView&, RawPixels&, const std::string& );
+  static void checkRawPixels( const RawPixels&, const std::string& );
+
+  // Shares the pixels, used by the OpenCV wrapper.
+  Registrator( const RawPixels&, const RawPixels&,
+               std::vector<int> &, std::vector<std::string> &,
+               const unsigned int );
+  bool isOutputRetained( OutputArtifact ) const;
+
+  /** @brief Prepared Fixed image, if registering against one; its pixels
+   *   are also those of _rawFixed. */
+  std::shared_ptr<const PreparedImage> _preparedFixed;
+  /** @brief Prepared Moving image, if given; its pixels are also those of
+   *   _rawMoving. */
+  std::shared_ptr<const PreparedImage> _preparedMoving;
+
 };
 
 }   // END namespace
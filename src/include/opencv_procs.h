@@ -28,24 +28,64 @@ identified are necessarily the best available for the purpose.
 #pragma once
 
 #include "nfrl_lib.h"
+#include "virtual_padded_image.h"
 
 #include <opencv2/core/core.hpp>
 
+#include <array>
+
 /**
  * @brief Friendly interfaces to OpenCV methods.
 */
 namespace CVops {
 
+/** @brief Count of pixels per 8-bit value. */
+typedef std::array<uint64_t, 256> Histogram;
+
+/** @brief Classes of 2x3 transforms, cheapest to apply first. */
+enum TransformClass
+{
+  /** No change. */
+  identityTransform = 0,
+  /** Whole-pixel translation: a placement, no resample. */
+  integerTranslation,
+  /** Rotation by a multiple of 90 degrees and a whole-pixel translation:
+   *  a transpose and/or flip, no resample. */
+  rightAngleRotation,
+  /** Anything else: needs a resample. */
+  generalTransform
+};
+
 void binarize_image_via_adaptive_threshold( const cv::Mat&, cv::Mat &, const int = 1 );
 void binarize_image_via_otsu_threshold( const cv::Mat&, cv::Mat &, const int& );
 void binarize_image_via_threshold( const cv::Mat&, cv::Mat&, const int&, const int& );
+TransformClass classify_transform( const cv::Mat&, const cv::Size&, int&, cv::Point& );
+cv::Mat color_overlay( const NFRL::VirtualPaddedImage&, const NFRL::VirtualPaddedImage& );
+cv::Mat color_overlay_indices( const NFRL::VirtualPaddedImage&, const NFRL::VirtualPaddedImage& );
+std::vector<uint8_t> color_overlay_palette();
+cv::Mat compose_affine_transforms( const cv::Mat&, const cv::Mat& );
 cv::Mat crop_image( const cv::Mat&, const cv::Rect& );
+void encode_png_palette( const cv::Mat&, const std::vector<uint8_t>&, std::vector<uint8_t>&, const std::vector<int>& = std::vector<int>() );
+void encode_pnm( const cv::Mat&, std::vector<uint8_t>& );
+cv::Mat footprint_warp_matrix( const NFRL::VirtualPaddedImage&, const cv::Mat&, const int&, cv::Rect& );
+Histogram footprint_histogram( const NFRL::VirtualPaddedImage&, const cv::Mat&, const cv::Size&, const int& );
+cv::Rect foreground_rect( const cv::Mat&, const int& );
+cv::Mat grayscale_image( const uint8_t*, const int&, const int&, const size_t&, const int& );
+Histogram image_histogram( const cv::Mat& );
 void image_dilate( const cv::Mat&, cv::Mat&, const int&, const int& );
-void sum_two_binary_images( const cv::Mat&, const cv::Mat&, cv::Mat& );
+double otsu_threshold( const Histogram&, const size_t& = 0, const uint8_t& = 255 );
+double otsu_threshold( const NFRL::VirtualPaddedImage& );
+bool place_exactly( const cv::Mat&, const TransformClass&, const int&, const cv::Point&, const cv::Size&, const cv::Scalar&, cv::Mat& );
+NFRL::VirtualPaddedImage place_footprint( const NFRL::VirtualPaddedImage&, const cv::Rect&, const int&, const cv::Point& );
+cv::Rect transformed_bounding_rect( const cv::Size&, const cv::Mat&, const int& );
+NFRL::VirtualPaddedImage warp_affine( const NFRL::VirtualPaddedImage&, const cv::Mat&, const int&, const int&, TransformClass&, const bool& = false );
+void warp_affine_region( const cv::Mat&, const cv::Mat&, const cv::Rect&, const int&, const uint8_t&, cv::Mat& );
+void warp_rigid_region( const cv::Mat&, const cv::Mat&, const cv::Rect&, const int&, const uint8_t&, cv::Mat& );
 
 Rotate2D cast_rotation_matrix( const cv::Mat& );
 Translate2D cast_translation_matrix( const cv::Mat& );
 std::string rotation_matrix_to_s( const cv::Mat& );
+const char* transform_class_name( const TransformClass );
 std::string translation_matrix_to_s( const cv::Mat& );
 
 }   // END namespace
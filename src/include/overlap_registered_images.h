@@ -27,6 +27,9 @@ identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #pragma once
 
+#include "binary_image.h"
+#include "virtual_padded_image.h"
+
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
 
@@ -49,8 +52,22 @@ private:
   /** @brief The minimum rectangle surrounding the *REGISTERED* moving image
    *   overlapping the fixed image. */
   cv::Rect _minRect;
-  /** @brief Byte-stream of overlay region only. */
-  std::vector<uint8_t> _vecPngBlob;
+  /** @brief Width and height of the (padded) canvas of the images. */
+  cv::Size _canvasSize;
+  /** @brief Canvas region where the binarized images may both be black;
+   *   only the region where both images have stored pixels. */
+  cv::Rect _overlapRect;
+  /** @brief Bits set where both binarized images are black, that is the
+   *   inverted "sum", over _overlapRect; clear elsewhere on the canvas.
+   *   Not built by the coarse-to-fine search until the blob is rendered. */
+  BinaryImage _overlap;
+  /** @brief Coarse-to-fine search: pixels per side of a coarse block, 0 for
+   *   the full-resolution search. */
+  int _coarseFactor{0};
+  /** @brief Images and Otsu thresholds of the coarse-to-fine search, kept
+   *   to build the overlap bits if the blob is rendered. */
+  VirtualPaddedImage _image1, _image2;
+  int _thresh1{0}, _thresh2{0};
 
   /** @brief OpenCV support for image dilation. */
   struct DilationKernelParams {
@@ -73,6 +90,13 @@ private:
   /** @brief Container for size and type of the dilation kernel. */
   _dilationKernelParams;
 
+  void calcOverlap( const VirtualPaddedImage&, const VirtualPaddedImage&,
+                    const int, const int );
+  cv::Rect calcOverlapCoarseToFine( const VirtualPaddedImage&,
+                                    const VirtualPaddedImage&,
+                                    const int, const int, const int );
+  void calcRegionOfInterest( const cv::Rect& );
+
   /** @brief Ensure that the ROI is valid. */
   bool isRegionOfInterestEmpty();
   bool isRegionOfInterestBelowThresh( std::string & );
@@ -90,6 +114,16 @@ public:
 
   /** @brief Full constructor used by NFRL. */
   OverlapRegisteredImages( cv::Mat, cv::Mat );
+  /** @brief Full constructor for virtually padded images. */
+  OverlapRegisteredImages( const VirtualPaddedImage&, const VirtualPaddedImage& );
+  /** @brief Full constructor for virtually padded images with known
+   *  Otsu thresholds, optionally searched coarse-to-fine. */
+  OverlapRegisteredImages( const VirtualPaddedImage&, const VirtualPaddedImage&,
+                           const int, const int, const int = 0 );
+  /** @brief Full constructor for an overlap already computed, e.g., by
+   *  TiledEngine. */
+  OverlapRegisteredImages( BinaryImage, const cv::Rect&, const cv::Size&,
+                           const cv::Rect& );
   virtual ~OverlapRegisteredImages() {}
 
   /** @brief Rectangle of overlap for cropping of source images. */
@@ -99,6 +133,8 @@ public:
 
   /** @brief Image used to calculate the common, ROI crop coordinates. */
   std::vector<uint8_t> getPngBlob() const;
+  /** @brief Same image as getPngBlob(), not encoded. */
+  cv::Mat getBlob() const;
 
   // Debug metadata
   std::string getStructuringElementParams();
@@ -0,0 +1,138 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "nfrl_lib.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+#ifdef USE_OPENCV
+  namespace NFRL {
+#else
+  namespace NFRL_ITL {
+#endif
+
+/**
+ * @brief Registers many pairs of images on a pool of worker threads.
+ *
+ * Each job is one pair of images, as byte-streams or as file paths, and its
+ * 8 control-point coordinates; jobs against the same reference may share a
+ * prepared Fixed image (see Registrator::PreparedImage).  The jobs are
+ * dealt to the workers in contiguous blocks; a worker that runs out of jobs
+ * steals from the far end of another worker's block, so uneven jobs do not
+ * leave workers idle.
+ * Each worker reuses its own input buffers (the control points and the
+ * buffers that files are read into) from one job to the next; only those
+ * are reused, as each job's Registrator allocates its own canvases, warps,
+ * histograms and overlap buffers.
+ *
+ * The results, and the error of each failed job, are returned in the order
+ * of the jobs; one failed job does not stop the others.
+ */
+class RegistrationBatch
+{
+public:
+  /** @brief One pair of images to register. */
+  struct Job
+  {
+    /** @brief Encoded Moving image; read from movingPath if null. */
+    Registrator::SharedBuffer moving;
+    /** @brief Encoded Fixed image; read from fixedPath if null. */
+    Registrator::SharedBuffer fixed;
+    /** @brief Prepared Fixed image, shared by the jobs against the same
+     *   reference; used instead of fixed and fixedPath if not null. */
+    std::shared_ptr<const Registrator::PreparedImage> preparedFixed;
+    /** @brief Prepared Moving image; used instead of moving and movingPath
+     *   if not null. */
+    std::shared_ptr<const Registrator::PreparedImage> preparedMoving;
+    /** @brief File of the Moving image, when not given as a byte-stream. */
+    std::string movingPath;
+    /** @brief File of the Fixed image, when not given as a byte-stream. */
+    std::string fixedPath;
+    /** @brief 8 coordinates of the corresponding points, see Registrator. */
+    std::vector<int> correspondingPoints;
+    /** @brief OutputArtifact bits of the outputs to return. */
+    unsigned int outputs{Registrator::allOutputs};
+  };
+
+  /** @brief Outcome of one job. */
+  struct Result
+  {
+    /** @brief The registration completed and its outputs were encoded. */
+    bool success{false};
+    /** @brief Exception message of a failed job. */
+    std::string error;
+    /** @brief Log of the registration, see Registrator; as far as it got
+     *   for a failed job. */
+    std::vector<std::string> metadata;
+    /** @brief Registration metadata of a successful job. */
+    Registrator::RegistrationMetadata registrationMetadata;
+    /** @brief Byte-stream of each selected output of a successful job. */
+    std::map<Registrator::OutputArtifact, std::vector<uint8_t>> images;
+  };
+
+private:
+  /** @brief Options of every registration. */
+  Registrator::RegistrationOptions _options;
+  /** @brief Worker threads, the calling thread included. */
+  int _workers{1};
+  /** @brief Set OpenCV's thread count to the threads of each registration
+   *   while the workers run. */
+  bool _limitOpenCvThreads{false};
+  /** @brief Jobs of the last run. */
+  int _jobCount{0};
+  /** @brief Jobs of the last run that were stolen from another worker. */
+  int _stolenCount{0};
+
+public:
+
+  void Init();
+
+  // Default constructor.
+  RegistrationBatch();
+
+  // Full constructor.
+  RegistrationBatch( const Registrator::RegistrationOptions&, const int = 0,
+                     const int = 1, const bool = false );
+  ~RegistrationBatch() {}
+
+  std::vector<Result> run( const std::vector<Job>& );
+
+  /** @brief Worker threads, the calling thread included. */
+  int workers() const { return _workers; }
+  /** @brief Threads of each registration, RegistrationOptions::threads. */
+  int innerThreads() const { return _options.threads; }
+
+  std::string to_s() const;
+};
+
+}   // END namespace
@@ -0,0 +1,96 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "nfrl_lib.h"
+#include "overlap_registered_images.h"
+#include "strip_png_encoder.h"
+#include "virtual_padded_image.h"
+
+#include <map>
+
+
+#ifdef USE_OPENCV
+  namespace NFRL {
+#else
+  namespace NFRL_ITL {
+#endif
+
+/**
+ * @brief Intermediate state of the last registration, retained so that each
+ * selected output is generated and encoded only when the caller requests it.
+ *
+ * For legacy padding the padded images hold the full canvases; for virtual
+ * padding they hold only the stored pixels and their offsets within the
+ * canvas.  State not needed by the selected outputs is released at the end
+ * of the registration.
+ */
+struct Registrator::Imagery
+{
+  /** @brief OutputArtifact bits selected for the registration. */
+  unsigned int outputs{0};
+  /** @brief Encode the color overlay as a palette PNG. */
+  bool paletteOverlay{false};
+  /** @brief Padded, grayscale Fixed image. */
+  NFRL::VirtualPaddedImage paddedFixed;
+  /** @brief Padded, registered, grayscale Moving image. */
+  NFRL::VirtualPaddedImage paddedRegisteredMoving;
+  /** @brief Overlap of the registered images, retains the ROI blob. */
+  std::unique_ptr<NFRL::OverlapRegisteredImages> overlap;
+  /** @brief Size of the padded canvas. */
+  cv::Size canvasSize;
+  /** @brief Crop region (ROI) in canvas coordinates. */
+  cv::Rect cropRegion;
+  /** @brief Output images rendered for raw-pixel views, by OutputArtifact. */
+  std::map<unsigned int, cv::Mat> rendered;
+  /** @brief Encoder settings of the outputs, by OutputArtifact; PNG if
+   *  not listed. */
+  std::map<unsigned int, EncoderSettings> encoders;
+  /** @brief Thread budget of the registration, at least 1. */
+  int threads{1};
+
+  cv::Mat cropMoving() const;
+  cv::Mat cropFixed() const;
+  cv::Mat renderColorOverlay() const;
+
+  cv::Mat render( const unsigned int ) const;
+  const cv::Mat& image( const unsigned int );
+  cv::Size imageSize( const unsigned int ) const;
+  int imageChannels( const unsigned int ) const;
+
+  EncoderSettings encoder( const unsigned int ) const;
+  void encode( const unsigned int, const cv::Mat&, std::vector<uint8_t>&,
+               const std::string& ) const;
+  bool write( const unsigned int, const cv::Mat&, const std::string& ) const;
+  NFRL::StripPngEncoder stripEncoder( const EncoderSettings& ) const;
+
+  static std::vector<int> pngParams( const EncoderSettings&,
+                                     const bool = false );
+};
+
+}   // END namespace
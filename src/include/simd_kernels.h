@@ -0,0 +1,94 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Vectorized pixel kernels behind the CVops interfaces.
+ *
+ * Each kernel processes one row (a run of contiguous bytes).  The kernel
+ * variant is selected at runtime per the CPU: AVX-512 (BW), AVX2, SSE2, or
+ * the scalar reference.  Every variant produces byte-identical results to
+ * the scalar reference, so outputs do not depend on the CPU.  Not every
+ * kernel has every variant; a level without one uses the next lower:
+ * ```
+ * kernel                  AVX-512  AVX2  SSSE3  SSE2
+ * min_bytes                  x      x           x
+ * pack_at_most               x      x           x
+ * overlay_tint                             x     (SSE2 level and up)
+ * overlay_palette_index                         x
+ * warp_bilinear_row                 x
+ * warp_nearest_row         (scalar only)
+ * ```
+ */
+namespace Kernels {
+
+/** @brief Instruction-set levels, in increasing order. */
+enum SimdLevel
+{
+  /** Portable C++, the reference for all other levels. */
+  scalar = 0,
+  sse2,
+  avx2,
+  avx512
+};
+
+SimdLevel detected_simd_level();
+SimdLevel simd_level();
+SimdLevel set_simd_level( const SimdLevel );
+const char* simd_level_name( const SimdLevel );
+
+void min_bytes( const uint8_t*, uint8_t*, const size_t );
+void pack_at_most( const uint8_t*, uint64_t*, const size_t, const int );
+void overlay_tint( const uint8_t*, const uint8_t*, uint8_t*, const size_t );
+void overlay_palette_index( const uint8_t*, const uint8_t*, uint8_t*, const size_t );
+
+/** @brief Fractional bits of the fixed-point warp coordinates. */
+const int WARP_COORD_BITS = 10;
+/** @brief Fractional bits of the bilinear warp weights. */
+const int WARP_WEIGHT_BITS = 8;
+
+/** @brief 8-bit, single-channel source of a warp. */
+struct WarpSource
+{
+  /** @brief First pixel. */
+  const uint8_t *data{nullptr};
+  /** @brief Bytes between rows. */
+  size_t step{0};
+  int width{0};
+  int height{0};
+  /** @brief Value of every pixel outside the source. */
+  uint8_t border{255};
+};
+
+void warp_bilinear_row( const WarpSource&, const int*, const int*, const int, const int, uint8_t*, const size_t );
+void warp_nearest_row( const WarpSource&, const int*, const int*, const int, const int, uint8_t*, const size_t );
+
+}   // END namespace
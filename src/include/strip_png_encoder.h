@@ -0,0 +1,92 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace NFRL {
+
+/**
+ * @brief PNG encoder that filters and deflates strips of rows concurrently.
+ *
+ * The image is cut into strips of whole rows, about STRIP_BYTES of pixels
+ * each.  Every strip is filtered and deflated as its own raw deflate stream,
+ * primed with the last 32 KiB of the strip before it and ended on a byte
+ * boundary (a sync flush), so the concatenated strips are one deflate
+ * stream.  The Adler-32 of the stream is combined from those of the strips,
+ * and each strip is one IDAT chunk whose CRC is computed by its own task.
+ *
+ * The strips do not depend on the number of threads, so neither does the
+ * byte-stream.  It is a standard PNG: it decodes with libpng (and OpenCV)
+ * to the same pixels as a PNG encoded by OpenCV, though its bytes differ.
+ */
+class StripPngEncoder
+{
+public:
+  /** @brief Bytes of pixels per strip, rounded to whole rows. */
+  static const int STRIP_BYTES = 256 * 1024;
+  /** @brief Filter each row with the filter that minimizes the sum of its
+   *   absolute, signed bytes, as libpng does by default. */
+  static const int ADAPTIVE_FILTER = -1;
+
+private:
+  /** @brief zlib level, 0 to 9. */
+  int _level{1};
+  /** @brief zlib strategy, e.g., Z_DEFAULT_STRATEGY. */
+  int _strategy{0};
+  /** @brief PNG filter type of every row, 0 (none) to 4 (Paeth), or
+   *   ADAPTIVE_FILTER. */
+  int _filter{1};
+  /** @brief Threads of an encode, the calling thread included. */
+  int _threads{1};
+
+public:
+
+  /** @brief Default constructor: level 1 and the Sub filter, as OpenCV's
+   *   defaults, on the calling thread. */
+  StripPngEncoder() {}
+
+  // Full constructor.
+  StripPngEncoder( const int, const int, const int, const int = 1 );
+  ~StripPngEncoder() {}
+
+  void encode( const cv::Mat&, std::vector<uint8_t>&, const bool = false,
+               const std::vector<uint8_t>& = std::vector<uint8_t>() ) const;
+
+  /** @brief zlib level, 0 to 9. */
+  int level() const { return _level; }
+  /** @brief PNG filter type of every row, or ADAPTIVE_FILTER. */
+  int filter() const { return _filter; }
+  /** @brief Threads of an encode. */
+  int threads() const { return _threads; }
+};
+
+}   // End namespace
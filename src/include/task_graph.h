@@ -0,0 +1,86 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <vector>
+
+namespace NFRL {
+
+/**
+ * @brief A small dependency graph of tasks, run on a bounded number of
+ *  threads.
+ *
+ * Tasks are added in an order where every dependency is added before the
+ * tasks that depend on it, so running them one at a time in that order is
+ * a valid schedule; run() with one thread does exactly that.  With more
+ * threads, a task starts as soon as its dependencies have completed.
+ *
+ * Tasks must write only their own results; the caller reads them after
+ * run().  If tasks throw, the exception of the first failed task (in the
+ * order added) is rethrown, as when run serially, and the tasks that depend
+ * on a failed task are skipped.
+ */
+class TaskGraph
+{
+public:
+  /** @brief Work of a task. */
+  typedef std::function<void()> Task;
+
+private:
+  /** @brief Work of each task. */
+  std::vector<Task> _tasks;
+  /** @brief Dependencies of each task. */
+  std::vector<std::vector<int>> _dependencies;
+  /** @brief Threads used by the last run. */
+  int _threadsUsed{0};
+
+  void runSerial( std::vector<std::exception_ptr>& );
+  void runParallel( const int, std::vector<std::exception_ptr>& );
+
+public:
+
+  void Init();
+
+  // Default constructor.
+  TaskGraph();
+  ~TaskGraph() {}
+
+  int add( Task, const std::vector<int>& = std::vector<int>() );
+  void run( const int );
+
+  /** @brief Number of tasks. */
+  int size() const { return static_cast<int>( _tasks.size() ); }
+  /** @brief Threads used by the last run. */
+  int threadsUsed() const { return _threadsUsed; }
+
+  static int threadBudget( const int );
+};
+
+}   // End namespace
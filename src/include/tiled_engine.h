@@ -0,0 +1,127 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "binary_image.h"
+#include "opencv_procs.h"
+#include "virtual_padded_image.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+namespace NFRL {
+
+/**
+ * @brief Warp, threshold and overlap of a registration, tile by tile.
+ *
+ * The canvas is processed in tiles small enough that each tile's pixels stay
+ * in cache from one step to the next, and tiles run in parallel.  Otsu needs
+ * the histogram of the whole canvas before anything is binarized, so there
+ * are two passes:
+ *
+ *   1. warp the Moving image, histogram both images and (optionally) render
+ *      the color overlay, per tile;
+ *   2. binarize and AND both images straight to bits and reduce the bounding
+ *      box of the overlap, per tile.
+ *
+ * Each tile is warped by CVops::warp_affine_region(), or by NFRL's
+ * fixed-point CVops::warp_rigid_region(), so the results do not depend on
+ * the tile size, the number of threads or the tile order.
+ */
+class TiledEngine
+{
+private:
+  /** @brief Tile width and height in pixels. */
+  int _tileSize{256};
+  /** @brief Warp with CVops::warp_rigid_region() instead of OpenCV. */
+  bool _fixedPointWarp{false};
+  /** @brief Number of tiles processed by the last run, both passes. */
+  int _tileCount{0};
+  /** @brief Class of the Moving transform of the last run, which chose
+   *   between placement and resample. */
+  CVops::TransformClass _transformClass{CVops::generalTransform};
+  /** @brief Width and height of the canvas. */
+  cv::Size _canvasSize;
+  /** @brief Registered Moving image, stored over its footprint. */
+  VirtualPaddedImage _registeredMoving;
+  /** @brief Otsu threshold of the registered Moving canvas. */
+  int _movingThresh{0};
+  /** @brief Otsu threshold of the Fixed canvas. */
+  int _fixedThresh{0};
+  /** @brief Color overlay canvas, empty unless requested. */
+  cv::Mat _overlay;
+  /** @brief Canvas region where both binaries may be black. */
+  cv::Rect _overlapRect;
+  /** @brief AND of the "at most threshold" bits over _overlapRect. */
+  BinaryImage _overlap;
+  /** @brief Bounding box of the set bits of _overlap, in its coordinates. */
+  cv::Rect _overlapBox;
+
+  void warpAndHistogram( const VirtualPaddedImage&, const cv::Mat&,
+                         const int&, const int&, const VirtualPaddedImage&,
+                         const bool );
+  void binarizeAndOverlap( const VirtualPaddedImage& );
+
+public:
+
+  void Init();
+
+  // Default constructor.
+  TiledEngine();
+
+  // Full constructor.
+  TiledEngine( const int, const bool = false );
+  ~TiledEngine() {}
+
+  void run( const VirtualPaddedImage&, const cv::Mat&, const int&,
+            const int&, const VirtualPaddedImage&, const bool );
+
+  /** @brief Tile width and height in pixels. */
+  int tileSize() const { return _tileSize; }
+  /** @brief Registered Moving image of the last run. */
+  const VirtualPaddedImage& registeredMoving() const { return _registeredMoving; }
+  /** @brief Class of the Moving transform of the last run. */
+  CVops::TransformClass transformClass() const { return _transformClass; }
+  /** @brief Otsu threshold of the registered Moving canvas. */
+  int movingThresh() const { return _movingThresh; }
+  /** @brief Otsu threshold of the Fixed canvas. */
+  int fixedThresh() const { return _fixedThresh; }
+  /** @brief Color overlay canvas, empty unless requested. */
+  const cv::Mat& overlay() const { return _overlay; }
+  /** @brief Canvas region of the overlap bits. */
+  cv::Rect overlapRect() const { return _overlapRect; }
+  /** @brief Overlap bits over overlapRect(). */
+  const BinaryImage& overlap() const { return _overlap; }
+  /** @brief Bounding box of the overlap bits, in their coordinates. */
+  cv::Rect overlapBox() const { return _overlapBox; }
+
+  std::string to_s() const;
+};
+
+}   // End namespace
@@ -0,0 +1,86 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+namespace NFRL {
+
+/**
+ * @brief A padded image that stores only its non-padding pixels.
+ *
+ * The image is the source pixels located at an offset within a larger canvas;
+ * every canvas pixel outside the source is the constant border value (white
+ * for NFRL padding).  Reading outside the source does not touch memory, and
+ * the full canvas is allocated only when it is materialized.
+ */
+class VirtualPaddedImage
+{
+private:
+  /** @brief Stored pixels, always within the canvas. */
+  cv::Mat _source;
+  /** @brief Location of the top-left source pixel within the canvas. */
+  cv::Point _offset;
+  /** @brief Width and height of the (virtual) padded canvas. */
+  cv::Size _canvasSize;
+  /** @brief Value of every canvas pixel outside the source. */
+  uint8_t _borderValue{255};
+
+public:
+
+  void Init();
+
+  // Default constructor.
+  VirtualPaddedImage();
+
+  // Full constructor.
+  VirtualPaddedImage( const cv::Mat&, const cv::Point&, const cv::Size&,
+                      const uint8_t = 255 );
+  ~VirtualPaddedImage() {}
+
+  /** @brief Stored pixels. */
+  const cv::Mat& source() const { return _source; }
+  /** @brief Location of the stored pixels within the canvas. */
+  cv::Point offset() const { return _offset; }
+  /** @brief Width and height of the canvas. */
+  cv::Size size() const { return _canvasSize; }
+  /** @brief Value of every pixel outside the stored pixels. */
+  uint8_t borderValue() const { return _borderValue; }
+  /** @brief True if there is no canvas. */
+  bool empty() const { return _canvasSize.area() == 0; }
+
+  cv::Rect sourceRect() const;
+  size_t paddingCount() const;
+  uint8_t at( int, int ) const;
+  const uint8_t* rowSpan( int, int, int, uint8_t* ) const;
+
+  cv::Mat materialize() const;
+  cv::Mat materialize( const cv::Rect& ) const;
+};
+
+}   // End namespace
@@ -0,0 +1,307 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "all_pairs_registration.h"
+#include "exceptions.h"
+#include "task_graph.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+
+
+#ifdef USE_OPENCV
+  namespace NFRL {
+#else
+  namespace NFRL_ITL {
+#endif
+
+namespace {
+
+typedef std::shared_ptr<const Registrator::PreparedImage> Prepared;
+
+/** @brief A prepared image of the set, or why it cannot be prepared. */
+struct Resident
+{
+  Prepared image;
+  std::string error;
+  /** @brief Last block that used the image. */
+  int lastUsed{-1};
+};
+
+/**
+ * @brief Decode and prepare one image of the set.
+ *
+ * @throw NFRL::Miscue cannot read, decode or prepare the image
+ */
+Prepared prepare_image( const AllPairsRegistration::Image &img )
+{
+  Registrator::SharedBuffer buffer = img.buffer;
+  if( !buffer )
+  {
+    std::ifstream ifs( img.path, std::ios::binary );
+    if( !ifs )
+      throw NFRL::Miscue( "cannot read image file: " + img.path );
+    buffer = std::make_shared<const std::vector<uint8_t>>(
+               std::istreambuf_iterator<char>( ifs ),
+               std::istreambuf_iterator<char>() );
+  }
+  return std::make_shared<const Registrator::PreparedImage>( buffer );
+}
+
+}   // END anonymous namespace
+
+
+/** @brief Initialization function that resets all values. */
+void AllPairsRegistration::Init()
+{
+  _blockSize = 0;
+  _blockCount = 0;
+  _preparedCount = 0;
+  _peakBytes = 0;
+}
+
+/** @brief Default constructor: default options, 1 GiB of prepared images,
+ *   one worker per hardware thread.  Calls Init(). */
+AllPairsRegistration::AllPairsRegistration()
+  : _batch( Registrator::RegistrationOptions(), 0, 1 ),
+    _memoryBudget( size_t(1) << 30 )
+{
+  Init();
+}
+
+/**
+ * @param options IN options of every registration
+ * @param memoryBudget IN bytes of prepared images that may stay resident
+ * @param workers IN worker threads, the calling thread included; 0 for all
+ *                hardware threads
+ * @param innerThreads IN threads of each registration, see RegistrationBatch
+ */
+AllPairsRegistration::AllPairsRegistration(
+  const Registrator::RegistrationOptions &options, const size_t memoryBudget,
+  const int workers, const int innerThreads )
+  : _batch( options, workers, innerThreads ), _memoryBudget( memoryBudget )
+{
+  Init();
+}
+
+/**
+ * @brief Register every pair.
+ *
+ * A pair whose image cannot be prepared, or whose indices are not those of
+ * the set, fails with the error; the other pairs are not affected.
+ *
+ * @param images IN set of images
+ * @param pairs IN pairs to register, by index into images
+ *
+ * @return result of each pair, in the order of the pairs
+ */
+std::vector<RegistrationBatch::Result>
+AllPairsRegistration::run( const std::vector<Image> &images,
+                           const std::vector<Pair> &pairs )
+{
+  Init();
+  const int n = static_cast<int>( images.size() );
+  std::vector<RegistrationBatch::Result> results( pairs.size() );
+  std::vector<Resident> residents( n );
+  size_t residentBytes{0};
+
+  // Prepare the images missing from a block, in parallel; the first image
+  // prepared sizes the blocks.
+  auto prepare = [&]( const std::set<int> &needed )
+  {
+    std::vector<int> missing;
+    for( const int i : needed )
+    {
+      if( !residents[i].image && residents[i].error.empty() )
+        missing.push_back( i );
+    }
+    NFRL::TaskGraph graph;
+    for( const int i : missing )
+    {
+      graph.add( [&, i]()
+      {
+        try {
+          residents[i].image = prepare_image( images[i] );
+        }
+        catch( const std::exception &e ) {
+          residents[i].error = "image " + std::to_string( i ) + ": " + e.what();
+        }
+      } );
+    }
+    graph.run( _batch.workers() );
+    for( const int i : missing )
+    {
+      if( residents[i].image )
+      {
+        residentBytes += residents[i].image->byteSize();
+        _preparedCount++;
+      }
+    }
+    _peakBytes = std::max( _peakBytes, residentBytes );
+  };
+
+  std::vector<int> valid;
+  for( size_t p=0; p<pairs.size(); p++ )
+  {
+    if( pairs[p].moving < 0 || pairs[p].moving >= n ||
+        pairs[p].fixed < 0 || pairs[p].fixed >= n )
+    {
+      results[p].error = "pair image index out of range";
+    }
+    else
+    {
+      valid.push_back( static_cast<int>( p ) );
+    }
+  }
+
+  // Size the blocks so that the 2 * blockSize images of a block fit the
+  // budget, from the first image of a pair, Moving or Fixed, that can be
+  // prepared.  If none can, nothing will be resident but the bookkeeping of
+  // the prepared images, so the blocks are sized for that.
+  size_t imageBytes{0};
+  for( size_t v=0; v<valid.size() && imageBytes == 0; v++ )
+  {
+    for( const int i : { pairs[valid[v]].moving, pairs[valid[v]].fixed } )
+    {
+      if( !residents[i].error.empty() )
+        continue;
+      prepare( { i } );
+      if( residents[i].image )
+      {
+        imageBytes = residents[i].image->byteSize();
+        break;
+      }
+    }
+  }
+  imageBytes = std::max( imageBytes, sizeof( Registrator::PreparedImage ) );
+  _blockSize = static_cast<int>( std::max<size_t>( 1,
+    std::min<size_t>( n, _memoryBudget / ( 2 * imageBytes ) ) ) );
+  const int blocksPerSide = ( n + _blockSize - 1 ) / _blockSize;
+
+  // Group the pairs by block, in pair order within each block.
+  std::map<std::pair<int,int>, std::vector<int>> blocks;
+  for( const int p : valid )
+  {
+    blocks[ std::make_pair( pairs[p].moving / _blockSize,
+                            pairs[p].fixed / _blockSize ) ].push_back( p );
+  }
+  std::vector<std::vector<int>> order;
+  for( int bm=0; bm<blocksPerSide; bm++ )
+  {
+    for( int k=0; k<blocksPerSide; k++ )
+    {
+      const int bf = ( bm % 2 == 0 ) ? k : blocksPerSide - 1 - k;
+      auto it = blocks.find( std::make_pair( bm, bf ) );
+      if( it != blocks.end() )
+        order.push_back( it->second );
+    }
+  }
+  _blockCount = static_cast<int>( order.size() );
+
+  for( int b=0; b<_blockCount; b++ )
+  {
+    std::set<int> needed;
+    for( const int p : order[b] )
+    {
+      needed.insert( pairs[p].moving );
+      needed.insert( pairs[p].fixed );
+    }
+
+    // Release the least recently used images the block does not need until
+    // the block's missing images fit the budget.
+    size_t incoming{0};
+    for( const int i : needed )
+    {
+      if( !residents[i].image && residents[i].error.empty() )
+        incoming += imageBytes;
+    }
+    std::vector<int> evictable;
+    for( int i=0; i<n; i++ )
+    {
+      if( residents[i].image && !needed.count( i ) )
+        evictable.push_back( i );
+    }
+    std::sort( evictable.begin(), evictable.end(), [&]( int a, int c )
+      { return residents[a].lastUsed < residents[c].lastUsed; } );
+    for( const int i : evictable )
+    {
+      if( residentBytes + incoming <= _memoryBudget )
+        break;
+      residentBytes -= residents[i].image->byteSize();
+      residents[i].image.reset();
+    }
+
+    prepare( needed );
+    std::vector<RegistrationBatch::Job> jobs;
+    std::vector<int> jobPairs;
+    for( const int p : order[b] )
+    {
+      const Resident &moving = residents[pairs[p].moving];
+      const Resident &fixed = residents[pairs[p].fixed];
+      if( !moving.image || !fixed.image )
+      {
+        results[p].error = !moving.image ? moving.error : fixed.error;
+        continue;
+      }
+      RegistrationBatch::Job job;
+      job.preparedMoving = moving.image;
+      job.preparedFixed = fixed.image;
+      job.correspondingPoints = pairs[p].correspondingPoints;
+      job.outputs = pairs[p].outputs;
+      jobs.push_back( std::move( job ) );
+      jobPairs.push_back( p );
+    }
+    for( const int i : needed )
+      residents[i].lastUsed = b;
+
+    std::vector<RegistrationBatch::Result> done = _batch.run( jobs );
+    for( size_t j=0; j<done.size(); j++ )
+      results[ jobPairs[j] ] = std::move( done[j] );
+  }
+  return results;
+}
+
+/**
+ * @return block size, block count, prepared images and peak resident bytes
+ *         of the last run in print format
+ */
+std::string AllPairsRegistration::to_s() const
+{
+  std::string s{"AllPairsRegistration:\n"};
+  s += " * Memory budget: " + std::to_string( _memoryBudget ) + " bytes\n";
+  s += " * Block size: " + std::to_string( _blockSize ) + " images, blocks: " +
+       std::to_string( _blockCount ) + "\n";
+  s += " * Images prepared: " + std::to_string( _preparedCount ) +
+       ", peak resident: " + std::to_string( _peakBytes ) + " bytes\n";
+  s += _batch.to_s();
+  return s;
+}
+
+}   // END namespace
@@ -0,0 +1,369 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "binary_image.h"
+#include "simd_kernels.h"
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace NFRL {
+
+namespace {
+
+/** @return index of the lowest set bit, word must not be zero */
+int first_bit( uint64_t word )
+{
+#if defined(_MSC_VER)
+  unsigned long idx;
+  _BitScanForward64( &idx, word );
+  return static_cast<int>( idx );
+#else
+  return __builtin_ctzll( word );
+#endif
+}
+
+/** @return index of the highest set bit, word must not be zero */
+int last_bit( uint64_t word )
+{
+#if defined(_MSC_VER)
+  unsigned long idx;
+  _BitScanReverse64( &idx, word );
+  return static_cast<int>( idx );
+#else
+  return 63 - __builtin_clzll( word );
+#endif
+}
+
+}   // END anonymous namespace
+
+
+/** @brief Initialization function that resets all values. */
+void BinaryImage::Init()
+{
+  _size = cv::Size( 0, 0 );
+  _wordsPerRow = 0;
+  _words.clear();
+}
+
+/** @brief Default constructor.  Calls Init(). */
+BinaryImage::BinaryImage()
+{
+  Init();
+}
+
+/**
+ * @param size IN width and height in pixels
+ * @param value IN initial value of every pixel
+ */
+BinaryImage::BinaryImage( const cv::Size &size, const bool value )
+  : _size(size), _wordsPerRow( ( size.width + 63 ) / 64 )
+{
+  if( size.width <= 0 || size.height <= 0 )
+  {
+    Init();
+    return;
+  }
+  _words.assign( static_cast<size_t>( _wordsPerRow ) * size.height,
+                 value ? ~uint64_t{0} : 0 );
+  if( value )
+  {
+    for( int y=0; y<_size.height; y++ )
+      row(y)[_wordsPerRow - 1] &= lastWordMask();
+  }
+}
+
+/**
+ * @brief Binarize an 8-bit image straight to bits, as the inverse of
+ *  OpenCV threshold() with THRESH_BINARY: set where the pixel is at most
+ *  the threshold (black in the 8-bit binary).
+ *
+ * @param img IN 8-bit, single-channel image
+ * @param thresh IN threshold
+ *
+ * @return bits set where img <= thresh
+ */
+BinaryImage BinaryImage::fromAtMost( const cv::Mat &img, const int thresh )
+{
+  BinaryImage bits( img.size() );
+  for( int y=0; y<bits._size.height; y++ )
+  {
+    Kernels::pack_at_most( img.ptr<uint8_t>(y), bits.row(y),
+                           bits._size.width, thresh );
+  }
+  return bits;
+}
+
+/** @return mask of the valid bits in the last word of a row */
+uint64_t BinaryImage::lastWordMask() const
+{
+  const int tail = _size.width & 63;
+  return ( tail == 0 ) ? ~uint64_t{0} : ( uint64_t{1} << tail ) - 1;
+}
+
+/**
+ * @param x IN column
+ * @param y IN row
+ *
+ * @return pixel value
+ */
+bool BinaryImage::at( int x, int y ) const
+{
+  return ( row(y)[x >> 6] >> ( x & 63 ) ) & 1;
+}
+
+/**
+ * @brief OR a run of bits into a row at any column.
+ *
+ * @param y IN row
+ * @param x IN column of the first bit
+ * @param bits IN run of bits starting at bit 0; bits past nbits must be clear
+ * @param nbits IN length of the run, x + nbits must not exceed the width
+ */
+void BinaryImage::orRow( int y, int x, const uint64_t *bits, int nbits )
+{
+  uint64_t *dst = row(y) + ( x >> 6 );
+  const int shift = x & 63;
+  const int nWords = ( nbits + 63 ) / 64;
+  const uint64_t *end = row(y) + _wordsPerRow;
+  for( int i=0; i<nWords; i++ )
+  {
+    dst[i] |= bits[i] << shift;
+    if( shift != 0 && dst + i + 1 < end )
+      dst[i+1] |= bits[i] >> ( 64 - shift );
+  }
+}
+
+/**
+ * @brief Intersection, word by word.
+ *
+ * @param other IN same size as this image
+ */
+BinaryImage& BinaryImage::operator&=( const BinaryImage &other )
+{
+  for( size_t i=0; i<_words.size(); i++ )
+    _words[i] &= other._words[i];
+  return *this;
+}
+
+/**
+ * @brief Union, word by word.
+ *
+ * @param other IN same size as this image
+ */
+BinaryImage& BinaryImage::operator|=( const BinaryImage &other )
+{
+  for( size_t i=0; i<_words.size(); i++ )
+    _words[i] |= other._words[i];
+  return *this;
+}
+
+/**
+ * @return inverted image
+ */
+BinaryImage BinaryImage::operator~() const
+{
+  BinaryImage out( *this );
+  for( size_t i=0; i<out._words.size(); i++ )
+    out._words[i] = ~out._words[i];
+  for( int y=0; y<_size.height; y++ )
+    out.row(y)[_wordsPerRow - 1] &= lastWordMask();
+  return out;
+}
+
+/**
+ * @brief Dilation by a 3x3 rectangle, as OpenCV dilate() with MORPH_RECT
+ *  of size 3 and the default border (pixels outside the image are clear).
+ *
+ * Separable: each row is ORed with itself shifted one column either way,
+ * then each row is ORed with its neighbor rows.
+ *
+ * @return dilated image
+ */
+BinaryImage BinaryImage::dilate3x3() const
+{
+  BinaryImage horz( _size );
+  const int n = _wordsPerRow;
+  for( int y=0; y<_size.height; y++ )
+  {
+    const uint64_t *src = row(y);
+    uint64_t *dst = horz.row(y);
+    for( int w=0; w<n; w++ )
+    {
+      const uint64_t cur = src[w];
+      const uint64_t prev = ( w > 0 ) ? src[w-1] : 0;
+      const uint64_t next = ( w + 1 < n ) ? src[w+1] : 0;
+      dst[w] = cur | ( cur << 1 ) | ( prev >> 63 ) | ( cur >> 1 ) | ( next << 63 );
+    }
+    dst[n - 1] &= lastWordMask();
+  }
+
+  BinaryImage out( _size );
+  for( int y=0; y<_size.height; y++ )
+  {
+    const uint64_t *mid = horz.row(y);
+    const uint64_t *up = ( y > 0 ) ? horz.row(y - 1) : nullptr;
+    const uint64_t *down = ( y + 1 < _size.height ) ? horz.row(y + 1) : nullptr;
+    uint64_t *dst = out.row(y);
+    for( int w=0; w<n; w++ )
+    {
+      dst[w] = mid[w] | ( up ? up[w] : 0 ) | ( down ? down[w] : 0 );
+    }
+  }
+  return out;
+}
+
+/**
+ * @brief Dilation by a (2k+1)x(2k+1) rectangle, as k dilations by 3x3.
+ *
+ * @param k IN half size of the rectangle; no dilation if not positive
+ *
+ * @return dilated image
+ */
+BinaryImage BinaryImage::dilate( const int k ) const
+{
+  BinaryImage out( *this );
+  for( int i=0; i<k; i++ )
+    out = out.dilate3x3();
+  return out;
+}
+
+/**
+ * @brief First and last set columns of a row.
+ *
+ * @param y IN row
+ * @param first OUT first set column
+ * @param last OUT last set column
+ *
+ * @return false if no pixel of the row is set
+ */
+bool BinaryImage::rowExtent( int y, int &first, int &last ) const
+{
+  const uint64_t *words = row(y);
+  int lo{0};
+  while( lo < _wordsPerRow && words[lo] == 0 )
+    lo++;
+  if( lo == _wordsPerRow )
+    return false;
+  int hi{_wordsPerRow - 1};
+  while( words[hi] == 0 )
+    hi--;
+  first = 64*lo + first_bit( words[lo] );
+  last = 64*hi + last_bit( words[hi] );
+  return true;
+}
+
+/**
+ * @brief Smallest rectangle holding every set pixel.
+ *
+ * @return bounding rectangle, empty if no pixel is set
+ */
+cv::Rect BinaryImage::boundingRect() const
+{
+  return boundingRect( cv::Rect( 0, 0, _size.width, _size.height ) );
+}
+
+/**
+ * @brief Smallest rectangle holding every set pixel within an area.
+ *
+ * Rows are ORed together word by word, so the columns are reduced once from
+ * the accumulated row rather than row by row.
+ *
+ * @param area IN area to search, within the image
+ *
+ * @return bounding rectangle in image coordinates, empty if no pixel of the
+ *         area is set
+ */
+cv::Rect BinaryImage::boundingRect( const cv::Rect &area ) const
+{
+  if( area.empty() )
+    return cv::Rect();
+  const int w0 = area.x >> 6;
+  const int w1 = ( area.x + area.width - 1 ) >> 6;
+  const int nWords = w1 - w0 + 1;
+  const uint64_t firstMask = ~uint64_t{0} << ( area.x & 63 );
+  const int endBit = ( area.x + area.width ) & 63;
+  const uint64_t lastMask = ( endBit == 0 ) ? ~uint64_t{0}
+                                            : ( uint64_t{1} << endBit ) - 1;
+
+  std::vector<uint64_t> cols( nWords, 0 );
+  int minRow{-1}, maxRow{-1};
+  for( int y=area.y; y<area.y + area.height; y++ )
+  {
+    const uint64_t *words = row(y) + w0;
+    uint64_t any{0};
+    for( int w=0; w<nWords; w++ )
+    {
+      uint64_t word = words[w];
+      if( w == 0 ) word &= firstMask;
+      if( w == nWords - 1 ) word &= lastMask;
+      cols[w] |= word;
+      any |= word;
+    }
+    if( any == 0 )
+      continue;
+    if( minRow < 0 )
+      minRow = y;
+    maxRow = y;
+  }
+  if( minRow < 0 )
+    return cv::Rect();
+
+  int lo{0};
+  while( cols[lo] == 0 )
+    lo++;
+  int hi{nWords - 1};
+  while( cols[hi] == 0 )
+    hi--;
+  const int minCol = 64*( w0 + lo ) + first_bit( cols[lo] );
+  const int maxCol = 64*( w0 + hi ) + last_bit( cols[hi] );
+  return cv::Rect( minCol, minRow, maxCol - minCol + 1, maxRow - minRow + 1 );
+}
+
+/**
+ * @brief Unpack to an 8-bit image.
+ *
+ * @param on IN value of set pixels
+ * @param off IN value of clear pixels
+ *
+ * @return 8-bit, single-channel image
+ */
+cv::Mat BinaryImage::toMat( const uint8_t on, const uint8_t off ) const
+{
+  cv::Mat img( _size, CV_8UC1 );
+  for( int y=0; y<_size.height; y++ )
+  {
+    const uint64_t *words = row(y);
+    uint8_t *dst = img.ptr<uint8_t>(y);
+    for( int x=0; x<_size.width; x++ )
+      dst[x] = ( ( words[x >> 6] >> ( x & 63 ) ) & 1 ) ? on : off;
+  }
+  return img;
+}
+
+}   // End namespace
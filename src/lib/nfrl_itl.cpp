@@ -26,6 +26,7 @@ of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #include "nfrl_itl.h"
+#include "registrator_imagery.h"
 
 #include <iostream>
 
@@ -42,6 +43,9 @@ Registrator::Registrator() : _correspondingPoints(_correspondingPoints),
  * reference.  This supports the potential for a corresponding-points-selection
  * 'retry' capability.  These two vectors may be cleared prior to each call
  * of the performRegistration() function.
+ *
+ * The image pixels are shared with the NFRL-core, not encoded or copied; the
+ * caller shall not modify them during the life of this object.
  * 
  * @param imgMoving IN 8-bit grayscale image to be registered with imgFixed
  * @param imgFixed IN 8-bit grayscale image to be registered-against
@@ -50,29 +54,24 @@ Registrator::Registrator() : _correspondingPoints(_correspondingPoints),
  *                            to perform the registration
  * @param metadata OUT reference to list of logging data generated by the
  *                 performRegistration() function
+ * @param outputs IN NFRL::Registrator::OutputArtifact bits of the outputs to
+ *                retain for retrieval
  * @throw NFRL::Miscue see NFRL-core NFRL::Registrator constructor
  */
 Registrator::Registrator( cv::Mat &imgMoving,
                           cv::Mat &imgFixed,
                           std::vector<int> &correspondingPoints,
-                          std::vector<std::string> &metadata )
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
   : _imgMovingMat(imgMoving), _imgFixedMat(imgFixed),
     _correspondingPoints(correspondingPoints), _metadata(metadata)
 {
-  std::vector<uint8_t> smallerImgData, largerImgData;
-
-  std::vector<int> param(1);
-  param[0] = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
   try
   {
-    cv::imencode(".png",
-                  imgMoving, smallerImgData,
-                  param);
-    cv::imencode(".png",
-                  imgFixed, largerImgData,
-                  param);
-
-    _r2.reset(new NFRL::Registrator( smallerImgData, largerImgData, _correspondingPoints, _metadata ));
+    _r2.reset(new NFRL::Registrator( sharePixels( imgMoving ),
+                                     sharePixels( imgFixed ),
+                                     _correspondingPoints, _metadata,
+                                     outputs ));
   }
   catch( NFRL::Miscue &e )
   {
@@ -81,6 +80,73 @@ Registrator::Registrator( cv::Mat &imgMoving,
   }
 }
 
+/**
+ * @brief Share the pixels of an image with the NFRL-core.
+ *
+ * 8-bit grayscale pixels are shared as they are.  Any other image is
+ * converted exactly as the NFRL-core converts an encoded image (PNG-encoded,
+ * then decoded as grayscale), so the registration is the same.
+ *
+ * @param img IN image
+ *
+ * @return pixels, kept alive by a reference to the image
+ * @throw NFRL::Miscue OpenCV cannot convert image
+ */
+NFRL::Registrator::RawPixels Registrator::sharePixels( const cv::Mat &img )
+{
+  cv::Mat gray = img;
+  if( !img.empty() && img.type() != CV_8UC1 )
+  {
+    try
+    {
+      std::vector<uint8_t> imgData;
+      std::vector<int> param(1);
+      param[0] = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
+      cv::imencode( ".png", img, imgData, param );
+      gray = cv::imdecode( cv::Mat(imgData), cv::IMREAD_GRAYSCALE );
+    }
+    catch( const cv::Exception& ex ) {
+      std::string err{"OpenCV cannot decode image: "};
+      err.append( ex.what() );
+      throw NFRL::Miscue( err );
+    }
+  }
+
+  NFRL::Registrator::RawPixels raw;
+  raw.data = std::shared_ptr<const uint8_t>( gray.data,
+                                             [gray]( const uint8_t* ) {} );
+  raw.width = gray.cols;
+  raw.height = gray.rows;
+  raw.stride = gray.empty() ? 0 : gray.step[0];
+  raw.channels = 1;
+  return raw;
+}
+
+/**
+ * @brief The NFRL-core's in-memory output image, shared (not copied).
+ *
+ * The image is shared with the NFRL-core, which allocated it and holds a
+ * reference to it; clone it before modifying it.  An output image may instead
+ * be a region of input pixels that the NFRL-core only wraps, without a
+ * reference count (e.g., the cropped Fixed image with virtual padding is a
+ * region of the Fixed input, see sharePixels()).  Such an image is copied,
+ * so the caller never gets a writable alias of an input image, nor one that
+ * dangles once this object and the inputs are destroyed.
+ *
+ * @param artifact IN output image
+ *
+ * @return image, empty if not selected for output
+ */
+cv::Mat Registrator::outputImage( NFRL::Registrator::OutputArtifact artifact )
+{
+  if( !_r2->isOutputRetained( artifact ) )
+    return cv::Mat();   // not selected for output
+  const cv::Mat &img = _r2->_imagery->image( artifact );
+  if( img.u == nullptr )
+    return img.clone();   // pixels not allocated by OpenCV
+  return img;
+}
+
 
 /**
  * @brief Wrapper method.
@@ -97,6 +163,24 @@ void Registrator::performRegistration()
   }
 }
 
+/**
+ * @brief Wrapper method.
+ *
+ * @param options IN transform mode and interpolation for this registration
+ */
+void Registrator::performRegistration(
+    const NFRL::Registrator::RegistrationOptions &options )
+{
+  try
+  {
+    _r2->performRegistration( options );
+  }
+  catch( NFRL::Miscue &e )
+  {
+    throw e;
+  }
+}
+
 /**
  * @brief Wrapper method.
  *
@@ -121,35 +205,35 @@ void Registrator::getXmlMetadata( XmlMetadata &m )
  * @brief Wrapper method to retrieve the padded, colorized, overlaid, registered
  *  image from memory.
  * 
- * @return encoded image
+ * @return image shared with the NFRL-core (see outputImage()), empty if not
+ *         selected for output
  */
 cv::Mat Registrator::getColorOverlaidRegisteredImages()
 {
-  std::vector<uint8_t> vec = _r2->getColorOverlaidRegisteredImages();
-  return cv::imdecode( cv::Mat(vec), cv::IMREAD_UNCHANGED );
+  return outputImage( NFRL::Registrator::colorOverlaidImage );
 }
 
 /**
  * @brief Wrapper method to retrieve the cropped, fixed image from memory.
  * 
- * @return encoded image
+ * @return image shared with the NFRL-core (see outputImage()), empty if not
+ *         selected for output
  */
 cv::Mat Registrator::getCroppedFixedImage()
 {
-  std::vector<uint8_t> vec = _r2->getCroppedFixedImage();
-  return cv::imdecode( cv::Mat(vec), cv::IMREAD_UNCHANGED );
+  return outputImage( NFRL::Registrator::croppedFixedImage );
 }
 
 /**
  * @brief Wrapper method to retrieve the cropped, registered image
  *  from memory.
  *
- * @return encoded image type as type OpenCV cv::Mat
+ * @return image shared with the NFRL-core (see outputImage()), empty if not
+ *         selected for output
  */
 cv::Mat Registrator::getCroppedRegisteredImage()
 {
-  std::vector<uint8_t> vec = _r2->getCroppedRegisteredImage();
-  return cv::imdecode( cv::Mat(vec), cv::IMREAD_UNCHANGED );
+  return outputImage( NFRL::Registrator::croppedRegisteredImage );
 }
 
 /** @brief Wrapper method.
@@ -191,35 +275,35 @@ int Registrator::getMovingPadSizeTop()
 /**
  * @brief Wrapper method.
  *
- * @return encoded image
+ * @return image shared with the NFRL-core (see outputImage()), empty if not
+ *         selected for output
  */
 cv::Mat Registrator::getPngBlob()
 {
-  std::vector<uint8_t> vec = _r2->getPngBlob();
-  return cv::imdecode( cv::Mat(vec), cv::IMREAD_UNCHANGED );
+  return outputImage( NFRL::Registrator::overlapBlob );
 }
 
 /**
  * @brief Wrapper method to retrieve the padded, grayscale Fixed image from memory.
  *
- * @return encoded image
+ * @return image shared with the NFRL-core (see outputImage()), empty if not
+ *         selected for output
  */
 cv::Mat Registrator::getPaddedFixedImg()
 {
-  std::vector<uint8_t> vec = _r2->getPaddedFixedImg();
-  return cv::imdecode( cv::Mat(vec), cv::IMREAD_UNCHANGED );
+  return outputImage( NFRL::Registrator::paddedFixedImage );
 }
 
 /**
  * @brief Wrapper method to retrieve the padded, registered, grayscale Moving
  * image from memory.
  * 
- * @return encoded image
+ * @return image shared with the NFRL-core (see outputImage()), empty if not
+ *         selected for output
  */
 cv::Mat Registrator::getPaddedRegisteredMovingImg()
 {
-  std::vector<uint8_t> vec = _r2->getPaddedRegisteredMovingImg();
-  return cv::imdecode( cv::Mat(vec), cv::IMREAD_UNCHANGED );
+  return outputImage( NFRL::Registrator::paddedRegisteredMovingImage );
 }
 
 /**
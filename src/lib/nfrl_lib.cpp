@@ -30,10 +30,16 @@ identified are necessarily the best available for the purpose.
 #include "opencv_procs.h"
 #include "overlap_registered_images.h"
 #include "points_on_images.h"
+#include "registrator_imagery.h"
+#include "task_graph.h"
+#include "tiled_engine.h"
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
+#include <zlib.h>
 
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <regex>
 
@@ -44,6 +50,28 @@ identified are necessarily the best available for the purpose.
   namespace NFRL_ITL {
 #endif
 
+#define WARP_SUPPORT_MARGIN 3   // pixels past source edge reached by a resample
+#define TRIM_MARGIN 16          // pixels kept around the trimmed foreground
+
+namespace {
+
+/** @return name of an output, as in Registrator::OutputArtifact */
+const char* artifact_name( const Registrator::OutputArtifact artifact )
+{
+  switch( artifact )
+  {
+    case Registrator::croppedRegisteredImage      : return "croppedRegisteredImage";
+    case Registrator::croppedFixedImage           : return "croppedFixedImage";
+    case Registrator::colorOverlaidImage          : return "colorOverlaidImage";
+    case Registrator::paddedFixedImage            : return "paddedFixedImage";
+    case Registrator::paddedRegisteredMovingImage : return "paddedRegisteredMovingImage";
+    case Registrator::overlapBlob                 : return "overlapBlob";
+    default                                       : return "allOutputs";
+  }
+}
+
+}   // END anonymous namespace
+
 /** @brief Initialization function that resets all values, not yet implemented. */
 void Registrator::Init() {}
 
@@ -80,6 +108,9 @@ Registrator::Registrator() : _correspondingPoints(_correspondingPoints),
  *   - overlaid padded and registered images, in color, for visual inspection
  *     of registration result.
  *
+ * The caller may select a subset of these outputs.  Each selected output is
+ * generated and encoded when it is first retrieved.
+ *
  * Note that the corresponding points and metadata variables are passed by
  * reference.  This supports the potential for a corresponding-points-selection
  * 'retry' capability.  These two vectors may be cleared prior to each call
@@ -99,22 +130,325 @@ Registrator::Registrator() : _correspondingPoints(_correspondingPoints),
  *                            to perform the registration
  * @param metadata OUT reference to list of logging data generated by the
  *                 performRegistration() function
+ * @param outputs IN OutputArtifact bits of the outputs to retain for
+ *                retrieval, all by default
  * @throw NFRL::Miscue for empty image or overlapping control-points
  */
 Registrator::Registrator( std::vector<uint8_t> imgMoving,
                           std::vector<uint8_t> imgFixed,
                           std::vector<int> &correspondingPoints,
-                          std::vector<std::string> &metadata )
-  : _imgMoving(imgMoving), _imgFixed(imgFixed),
-    _correspondingPoints(correspondingPoints), _metadata(metadata)
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
+  : _imgMoving(std::make_shared<const std::vector<uint8_t>>(
+                 std::move(imgMoving))),
+    _imgFixed(std::make_shared<const std::vector<uint8_t>>(
+                 std::move(imgFixed))),
+    _correspondingPoints(correspondingPoints), _metadata(metadata),
+    _outputs(outputs)
+{
+  // Check input parameters
+  if( _imgMoving->empty() )
+    throw NFRL::Miscue( "moving img buffer is empty" );
+  if( _imgFixed->empty() )
+    throw NFRL::Miscue( "fixed img buffer is empty" );
+}
+
+/**
+ * @brief Same as the byte-stream constructor, but the byte-streams are
+ *  shared with the caller instead of copied.
+ *
+ * The byte-streams are immutable; any number of Registrators, in any number
+ * of threads, may share them.
+ *
+ * @param imgMoving IN encoded image to be registered with imgFixed
+ * @param imgFixed IN encoded image to be registered-against (by imgMoving)
+ * @param correspondingPoints IN list of corresponding control points used
+ *                            to perform the registration
+ * @param metadata OUT reference to list of logging data generated by the
+ *                 performRegistration() function
+ * @param outputs IN OutputArtifact bits of the outputs to retain for
+ *                retrieval, all by default
+ * @throw NFRL::Miscue for empty image
+ */
+Registrator::Registrator( SharedBuffer imgMoving,
+                          SharedBuffer imgFixed,
+                          std::vector<int> &correspondingPoints,
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
+  : _imgMoving(std::move(imgMoving)), _imgFixed(std::move(imgFixed)),
+    _correspondingPoints(correspondingPoints), _metadata(metadata),
+    _outputs(outputs)
 {
   // Check input parameters
-  if( _imgMoving.empty() )
+  if( !_imgMoving || _imgMoving->empty() )
+    throw NFRL::Miscue( "moving img buffer is empty" );
+  if( !_imgFixed || _imgFixed->empty() )
+    throw NFRL::Miscue( "fixed img buffer is empty" );
+}
+
+/**
+ * @brief Registrator for images the caller has already decoded.
+ *
+ * Same as the byte-stream constructor, but each image is given as 8-bit
+ * pixels.  The pixels are copied, so the caller's buffers need not outlive
+ * this object.  Color pixels are converted to grayscale by the registration
+ * and the registration metadata is updated to indicate the conversion.
+ *
+ * @param imgMoving IN pixels to be registered with imgFixed
+ * @param imgFixed IN pixels to be registered-against (by imgMoving)
+ * @param correspondingPoints IN list of corresponding control points used
+ *                            to perform the registration
+ * @param metadata OUT reference to list of logging data generated by the
+ *                 performRegistration() function
+ * @param outputs IN OutputArtifact bits of the outputs to retain for
+ *                retrieval, all by default
+ * @throw NFRL::Miscue for empty image or unsupported pixel layout
+ */
+Registrator::Registrator( const ImageView &imgMoving,
+                          const ImageView &imgFixed,
+                          std::vector<int> &correspondingPoints,
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
+  : _correspondingPoints(correspondingPoints), _metadata(metadata),
+    _outputs(outputs)
+{
+  copyRawPixels( imgMoving, _rawMoving, "moving" );
+  copyRawPixels( imgFixed, _rawFixed, "fixed" );
+}
+
+/**
+ * @brief Registrator that shares already-decoded pixels, used by the OpenCV
+ *  wrapper.
+ *
+ * @param imgMoving IN pixels to be registered with imgFixed
+ * @param imgFixed IN pixels to be registered-against (by imgMoving)
+ * @param correspondingPoints IN list of corresponding control points
+ * @param metadata OUT reference to list of logging data
+ * @param outputs IN OutputArtifact bits of the outputs to retain
+ * @throw NFRL::Miscue for empty image or unsupported pixel layout
+ */
+Registrator::Registrator( const RawPixels &imgMoving,
+                          const RawPixels &imgFixed,
+                          std::vector<int> &correspondingPoints,
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
+  : _rawMoving(imgMoving), _rawFixed(imgFixed),
+    _correspondingPoints(correspondingPoints), _metadata(metadata),
+    _outputs(outputs)
+{
+  checkRawPixels( _rawMoving, "moving" );
+  checkRawPixels( _rawFixed, "fixed" );
+}
+
+/**
+ * @brief Registrator of a Moving image against a prepared Fixed image.
+ *
+ * The pixels, histogram and foreground of the Fixed image are those of the
+ * prepared image; it is shared, not copied, so it may be shared by any
+ * number of Registrators in any number of threads.
+ *
+ * @param imgMoving IN encoded image to be registered with imgFixed
+ * @param imgFixed IN prepared image to be registered-against (by imgMoving)
+ * @param correspondingPoints IN list of corresponding control points
+ * @param metadata OUT reference to list of logging data
+ * @param outputs IN OutputArtifact bits of the outputs to retain
+ * @throw NFRL::Miscue for empty image
+ */
+Registrator::Registrator( SharedBuffer imgMoving,
+                          std::shared_ptr<const PreparedImage> imgFixed,
+                          std::vector<int> &correspondingPoints,
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
+  : _imgMoving(std::move(imgMoving)),
+    _correspondingPoints(correspondingPoints), _metadata(metadata),
+    _outputs(outputs), _preparedFixed(std::move(imgFixed))
+{
+  if( !_imgMoving || _imgMoving->empty() )
+    throw NFRL::Miscue( "moving img buffer is empty" );
+  if( !_preparedFixed )
+    throw NFRL::Miscue( "fixed img buffer is empty" );
+  _rawFixed = _preparedFixed->_pixels;
+}
+
+/**
+ * @brief Registrator of a prepared Moving image against a prepared Fixed
+ *  image.
+ *
+ * Both images are shared, not copied; see the constructor for a prepared
+ * Fixed image.
+ *
+ * @param imgMoving IN prepared image to be registered with imgFixed
+ * @param imgFixed IN prepared image to be registered-against (by imgMoving)
+ * @param correspondingPoints IN list of corresponding control points
+ * @param metadata OUT reference to list of logging data
+ * @param outputs IN OutputArtifact bits of the outputs to retain
+ * @throw NFRL::Miscue for empty image
+ */
+Registrator::Registrator( std::shared_ptr<const PreparedImage> imgMoving,
+                          std::shared_ptr<const PreparedImage> imgFixed,
+                          std::vector<int> &correspondingPoints,
+                          std::vector<std::string> &metadata,
+                          const unsigned int outputs )
+  : _correspondingPoints(correspondingPoints), _metadata(metadata),
+    _outputs(outputs), _preparedFixed(std::move(imgFixed)),
+    _preparedMoving(std::move(imgMoving))
+{
+  if( !_preparedMoving )
     throw NFRL::Miscue( "moving img buffer is empty" );
-  if( _imgFixed.empty() )
+  if( !_preparedFixed )
     throw NFRL::Miscue( "fixed img buffer is empty" );
+  _rawMoving = _preparedMoving->_pixels;
+  _rawFixed = _preparedFixed->_pixels;
 }
 
+/**
+ * @brief Decode an image to grayscale and prepare it.
+ *
+ * @param img IN encoded image
+ * @throw NFRL::Miscue for empty image, or OpenCV cannot decode the image
+ */
+Registrator::PreparedImage::PreparedImage( const SharedBuffer &img )
+{
+  if( !img || img->empty() )
+    throw NFRL::Miscue( "prepared img buffer is empty" );
+  try {
+    auto gray = std::make_shared<cv::Mat>(
+                  cv::imdecode( cv::Mat(*img), cv::IMREAD_GRAYSCALE ) );
+    if( gray->empty() )
+      throw NFRL::Miscue( "OpenCV cannot decode image: prepared" );
+    _pixels.data = std::shared_ptr<const uint8_t>( gray, gray->data );
+    _pixels.width = gray->cols;
+    _pixels.height = gray->rows;
+    _pixels.stride = gray->step[0];
+    _pixels.channels = 1;
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"OpenCV cannot decode image: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+  prepare();
+}
+
+/**
+ * @brief Prepare 8-bit pixels; color pixels are converted to grayscale.
+ *
+ * @param img IN caller's pixels, copied
+ * @throw NFRL::Miscue for empty image or unsupported pixel layout
+ */
+Registrator::PreparedImage::PreparedImage( const ImageView &img )
+{
+  RawPixels raw;
+  copyRawPixels( img, raw, "prepared" );
+  _converted = raw.channels > 1;
+  if( !_converted )
+  {
+    _pixels = raw;
+  }
+  else
+  {
+    try {
+      auto gray = std::make_shared<cv::Mat>(
+                    CVops::grayscale_image( raw.data.get(), raw.width,
+                                            raw.height, raw.stride,
+                                            raw.channels ) );
+      _pixels.data = std::shared_ptr<const uint8_t>( gray, gray->data );
+      _pixels.width = gray->cols;
+      _pixels.height = gray->rows;
+      _pixels.stride = gray->step[0];
+      _pixels.channels = 1;
+    }
+    catch( const cv::Exception& ex ) {
+      std::string err{"OpenCV cannot convert image to grayscale: "};
+      err.append( ex.what() );
+      throw NFRL::Miscue( err );
+    }
+  }
+  prepare();
+}
+
+/**
+ * @brief Histogram the grayscale pixels and find their foreground, with
+ *  the histogram of the foreground.
+ *
+ * @throw NFRL::Miscue OpenCV cannot trim the image
+ */
+void Registrator::PreparedImage::prepare()
+{
+  try {
+    const cv::Mat gray = CVops::grayscale_image( _pixels.data.get(),
+                                                 _pixels.width, _pixels.height,
+                                                 _pixels.stride, 1 );
+    _histogram = CVops::image_histogram( gray );
+    const cv::Rect foreground = CVops::foreground_rect( gray, TRIM_MARGIN );
+    _foreground = { foreground.x, foreground.y,
+                    foreground.width, foreground.height };
+    _foregroundHistogram = CVops::image_histogram( gray( foreground ) );
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"OpenCV cannot trim image: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+}
+
+/**
+ * @brief Validate the layout of input pixels.
+ *
+ * @param raw IN pixels
+ * @param name IN "moving", "fixed" or "prepared", for the exception message
+ *
+ * @throw NFRL::Miscue for empty image or unsupported pixel layout
+ */
+void Registrator::checkRawPixels( const RawPixels &raw,
+                                  const std::string &name )
+{
+  if( !raw.data || raw.width <= 0 || raw.height <= 0 )
+    throw NFRL::Miscue( name + " img buffer is empty" );
+  if( raw.channels != 1 && raw.channels != 3 && raw.channels != 4 )
+    throw NFRL::Miscue( name + " img channels must be 1, 3, or 4" );
+  if( raw.stride < static_cast<size_t>( raw.width ) * raw.channels )
+    throw NFRL::Miscue( name + " img stride less than row width" );
+}
+
+/**
+ * @brief Validate and copy caller-owned pixels, rows packed.
+ *
+ * @param view IN caller's pixels
+ * @param raw OUT owned copy
+ * @param name IN "moving", "fixed" or "prepared", for the exception message
+ *
+ * @throw NFRL::Miscue for empty image or unsupported pixel layout
+ */
+void Registrator::copyRawPixels( const ImageView &view, RawPixels &raw,
+                                 const std::string &name )
+{
+  RawPixels caller;
+  caller.data = std::shared_ptr<const uint8_t>( view.data,
+                                                []( const uint8_t* ) {} );
+  caller.width = view.width;
+  caller.height = view.height;
+  caller.stride = view.stride;
+  caller.channels = view.channels;
+  checkRawPixels( caller, name );
+
+  const size_t rowBytes = static_cast<size_t>( view.width ) * view.channels;
+  auto pixels = std::make_shared<std::vector<uint8_t>>( rowBytes * view.height );
+  for( int i=0; i<view.height; i++ )
+  {
+    std::copy( view.data + i * view.stride,
+               view.data + i * view.stride + rowBytes,
+               pixels->begin() + i * rowBytes );
+  }
+
+  raw = caller;
+  raw.data = std::shared_ptr<const uint8_t>( pixels, pixels->data() );
+  raw.stride = rowBytes;
+}
+
+/** @brief Destructor, releases retained imagery. */
+Registrator::~Registrator() {}
+
 /** @brief Copy constructor.  This is called when passing the object by value
  *   as parameter to Registrator constructor.
  * 
@@ -127,82 +461,357 @@ Registrator::Registrator( const Registrator& ) :
 /**
  * @brief Retrieves the padded, colorized, overlaid, registered image from memory.
  *
- * @return byte-stream
+ * The overlay is rendered and encoded on the first call after each
+ * registration.  If RegistrationOptions::paletteOverlay was set, it is
+ * encoded as an 8-bit palette PNG of 16 levels per image (unless another
+ * format is set for it, see RegistrationOptions::encoders).
+ *
+ * @return byte-stream, empty if not selected for output; valid until the
+ *         next registration or release
+ * @throw NFRL::Miscue OpenCV cannot colorize, merge, or save the overlay
  */
-std::vector<uint8_t> Registrator::getColorOverlaidRegisteredImages()
+const std::vector<uint8_t>& Registrator::getColorOverlaidRegisteredImages()
 {
+  if( _vecColorOverlaidRegisteredImages.empty() &&
+      isOutputRetained( colorOverlaidImage ) )
+  {
+    if( _imagery->paletteOverlay )
+    {
+      const EncoderSettings settings = _imagery->encoder( colorOverlaidImage );
+      try {
+        const cv::Mat indices =
+          CVops::color_overlay_indices( _imagery->paddedRegisteredMoving,
+                                        _imagery->paddedFixed );
+        if( settings.parallelPng )
+        {
+          _imagery->stripEncoder( settings ).encode(
+            indices, _vecColorOverlaidRegisteredImages, false,
+            CVops::color_overlay_palette() );
+        }
+        else
+        {
+          CVops::encode_png_palette( indices, CVops::color_overlay_palette(),
+                                     _vecColorOverlaidRegisteredImages,
+                                     Imagery::pngParams( settings ) );
+        }
+      }
+      catch( const cv::Exception& ex ) {
+        std::string err{"OpenCV cannot save overlaid images: "};
+        err.append( ex.what() );
+        throw NFRL::Miscue( err );
+      }
+    }
+    else
+    {
+      _imagery->encode( colorOverlaidImage,
+                        _imagery->render( colorOverlaidImage ),
+                        _vecColorOverlaidRegisteredImages,
+                        "OpenCV cannot save overlaid images: " );
+    }
+  }
   return _vecColorOverlaidRegisteredImages;
 }
 
 /**
  * @brief Retrieves the cropped, registered image (that was moved) from memory.
  *
- * @return byte-stream
+ * The image is encoded on the first call after each registration.
+ *
+ * @return byte-stream, empty if not selected for output; valid until the
+ *         next registration or release
+ * @throw NFRL::Miscue OpenCV cannot crop or save final images
  */
-std::vector<uint8_t> Registrator::getCroppedRegisteredImage()
+const std::vector<uint8_t>& Registrator::getCroppedRegisteredImage()
 {
+  if( _vecCroppedRegisteredImage.empty() &&
+      isOutputRetained( croppedRegisteredImage ) )
+  {
+    _imagery->encode( croppedRegisteredImage,
+                      _imagery->render( croppedRegisteredImage ),
+                      _vecCroppedRegisteredImage,
+                      "OpenCV cannot crop or save final images: " );
+  }
   return _vecCroppedRegisteredImage;
 }
 
 /** @brief Retrieves the cropped, fixed image from memory.
  *
- * @return byte-stream
+ * The image is encoded on the first call after each registration.
+ *
+ * @return byte-stream, empty if not selected for output; valid until the
+ *         next registration or release
+ * @throw NFRL::Miscue OpenCV cannot crop or save final images
  */
-std::vector<uint8_t> Registrator::getCroppedFixedImage()
+const std::vector<uint8_t>& Registrator::getCroppedFixedImage()
 {
+  if( _vecCroppedFixedImage.empty() && isOutputRetained( croppedFixedImage ) )
+  {
+    _imagery->encode( croppedFixedImage,
+                      _imagery->render( croppedFixedImage ),
+                      _vecCroppedFixedImage,
+                      "OpenCV cannot crop or save final images: " );
+  }
   return _vecCroppedFixedImage;
 }
 
 /** @brief Retrieves the padded, grayscale Fixed image from memory.
  *
- * @return byte-stream
+ * The padded image is materialized and encoded on the first call after each
+ * registration.
+ *
+ * @return byte-stream, empty if not selected for output; valid until the
+ *         next registration or release
+ * @throw NFRL::Miscue OpenCV cannot save padded image
  */
-std::vector<uint8_t> Registrator::getPaddedFixedImg()
+const std::vector<uint8_t>& Registrator::getPaddedFixedImg()
 {
+  if( _vecPaddedFixedImg.empty() && isOutputRetained( paddedFixedImage ) )
+  {
+    _imagery->encode( paddedFixedImage,
+                      _imagery->render( paddedFixedImage ),
+                      _vecPaddedFixedImg,
+                      "OpenCV cannot save padded image: " );
+  }
   return _vecPaddedFixedImg;
 }
 
 /**
  * @brief Retrieves the padded, registered, grayscale Moving image from memory.
  *
- * @return byte-stream
+ * The padded image is materialized and encoded on the first call after each
+ * registration.
+ *
+ * @return byte-stream, empty if not selected for output; valid until the
+ *         next registration or release
+ * @throw NFRL::Miscue OpenCV cannot save padded image
  */
-std::vector<uint8_t> Registrator::getPaddedRegisteredMovingImg()
+const std::vector<uint8_t>& Registrator::getPaddedRegisteredMovingImg()
 {
+  if( _vecPaddedRegisteredMovingImg.empty() &&
+      isOutputRetained( paddedRegisteredMovingImage ) )
+  {
+    _imagery->encode( paddedRegisteredMovingImage,
+                      _imagery->render( paddedRegisteredMovingImage ),
+                      _vecPaddedRegisteredMovingImg,
+                      "OpenCV cannot save padded image: " );
+  }
   return _vecPaddedRegisteredMovingImg;
 }
 
 /**
  * @brief Retrieves the blob region from which ROI coords were calculated.
  *
- * This is a PNG-compressed image.
+ * This is a PNG-compressed image, unless another encoder is set for it (see
+ * RegistrationOptions::encoders), rendered on the first call after each
+ * registration.
  * 
- * @return byte-stream
+ * @return byte-stream, empty if not selected for output; valid until the
+ *         next registration or release
+ * @throw NFRL::Miscue OverlapRegisteredImages, cannot save blob
  */
-std::vector<uint8_t> Registrator::getPngBlob()
+const std::vector<uint8_t>& Registrator::getPngBlob()
 {
+  if( _vecPngBlob.empty() && isOutputRetained( overlapBlob ) )
+  {
+    _imagery->encode( overlapBlob, _imagery->render( overlapBlob ),
+                      _vecPngBlob, "OverlapRegisteredImages, cannot save blob: " );
+  }
   return _vecPngBlob;
 }
 
+/**
+ * @brief Encodes every selected output not yet encoded, each output on its
+ *  own thread within RegistrationOptions::threads.
+ *
+ * The byte-streams are those the getters return, and the getters then
+ * return them without encoding again.
+ *
+ * @throw NFRL::Miscue first output, in getter order, that cannot be encoded
+ */
+void Registrator::encodeSelectedOutputs()
+{
+  NFRL::TaskGraph encoding;
+  if( _vecCroppedRegisteredImage.empty() &&
+      isOutputRetained( croppedRegisteredImage ) )
+    encoding.add( [this]{ getCroppedRegisteredImage(); } );
+  if( _vecCroppedFixedImage.empty() && isOutputRetained( croppedFixedImage ) )
+    encoding.add( [this]{ getCroppedFixedImage(); } );
+  if( _vecColorOverlaidRegisteredImages.empty() &&
+      isOutputRetained( colorOverlaidImage ) )
+    encoding.add( [this]{ getColorOverlaidRegisteredImages(); } );
+  if( _vecPaddedFixedImg.empty() && isOutputRetained( paddedFixedImage ) )
+    encoding.add( [this]{ getPaddedFixedImg(); } );
+  if( _vecPaddedRegisteredMovingImg.empty() &&
+      isOutputRetained( paddedRegisteredMovingImage ) )
+    encoding.add( [this]{ getPaddedRegisteredMovingImg(); } );
+  if( _vecPngBlob.empty() && isOutputRetained( overlapBlob ) )
+    encoding.add( [this]{ getPngBlob(); } );
+  encoding.run( _imagery ? _imagery->threads : 1 );
+}
+
+
+/**
+ * @brief Moves the padded, colorized, overlaid, registered image out of this object.
+ *
+ * A later call to getColorOverlaidRegisteredImages() encodes it again.
+ *
+ * @return byte-stream, empty if not selected for output
+ */
+std::vector<uint8_t> Registrator::releaseColorOverlaidRegisteredImages()
+{
+  getColorOverlaidRegisteredImages();
+  std::vector<uint8_t> vec;
+  vec.swap( _vecColorOverlaidRegisteredImages );
+  return vec;
+}
+
+/**
+ * @brief Moves the cropped, registered image out of this object.
+ *
+ * A later call to getCroppedRegisteredImage() encodes it again.
+ *
+ * @return byte-stream, empty if not selected for output
+ */
+std::vector<uint8_t> Registrator::releaseCroppedRegisteredImage()
+{
+  getCroppedRegisteredImage();
+  std::vector<uint8_t> vec;
+  vec.swap( _vecCroppedRegisteredImage );
+  return vec;
+}
+
+/**
+ * @brief Moves the cropped, fixed image out of this object.
+ *
+ * A later call to getCroppedFixedImage() encodes it again.
+ *
+ * @return byte-stream, empty if not selected for output
+ */
+std::vector<uint8_t> Registrator::releaseCroppedFixedImage()
+{
+  getCroppedFixedImage();
+  std::vector<uint8_t> vec;
+  vec.swap( _vecCroppedFixedImage );
+  return vec;
+}
+
+/**
+ * @brief Moves the padded, grayscale Fixed image out of this object.
+ *
+ * A later call to getPaddedFixedImg() encodes it again.
+ *
+ * @return byte-stream, empty if not selected for output
+ */
+std::vector<uint8_t> Registrator::releasePaddedFixedImg()
+{
+  getPaddedFixedImg();
+  std::vector<uint8_t> vec;
+  vec.swap( _vecPaddedFixedImg );
+  return vec;
+}
+
+/**
+ * @brief Moves the padded, registered, grayscale Moving image out of this object.
+ *
+ * A later call to getPaddedRegisteredMovingImg() encodes it again.
+ *
+ * @return byte-stream, empty if not selected for output
+ */
+std::vector<uint8_t> Registrator::releasePaddedRegisteredMovingImg()
+{
+  getPaddedRegisteredMovingImg();
+  std::vector<uint8_t> vec;
+  vec.swap( _vecPaddedRegisteredMovingImg );
+  return vec;
+}
+
+/**
+ * @brief Moves the blob region from which ROI coords were calculated out of this object.
+ *
+ * A later call to getPngBlob() encodes it again.
+ *
+ * @return byte-stream, empty if not selected for output
+ */
+std::vector<uint8_t> Registrator::releasePngBlob()
+{
+  getPngBlob();
+  std::vector<uint8_t> vec;
+  vec.swap( _vecPngBlob );
+  return vec;
+}
+
+
+/**
+ * @brief Raw pixels of an output image, without encoding.
+ *
+ * The image is rendered on the first call after each registration (cropped
+ * and legacy-padded images are not copied) and is retained by this object.
+ *
+ * @param artifact IN output image to view
+ *
+ * @return view of the pixels, empty if not selected for output
+ * @throw NFRL::Miscue OpenCV cannot render the image
+ */
+Registrator::ImageView Registrator::getImageView( OutputArtifact artifact )
+{
+  ImageView view;
+  if( !isOutputRetained( artifact ) )
+    return view;
+
+  const cv::Mat &img = _imagery->image( artifact );
+  if( img.empty() )
+    return view;
+  view.data = img.ptr<uint8_t>(0);
+  view.width = img.cols;
+  view.height = img.rows;
+  view.stride = img.step[0];
+  view.channels = img.channels();
+  return view;
+}
+
+/**
+ * @brief Number of bytes of an output image with rows packed, that is,
+ *  width * height * channels.
+ *
+ * The size is known as soon as the registration completes; the image is not
+ * rendered.
+ *
+ * @param artifact IN output image
+ *
+ * @return byte count, zero if not selected for output
+ */
+size_t Registrator::getImageByteSize( OutputArtifact artifact ) const
+{
+  if( !isOutputRetained( artifact ) )
+    return 0;
+  cv::Size size = _imagery->imageSize( artifact );
+  return static_cast<size_t>( size.width ) * size.height *
+         _imagery->imageChannels( artifact );
+}
+
 
 /**
  * @brief  Enable the using software the option to save image to disk.
  *
+ * The format is that of the file extension; a PNG is written with the PNG
+ * settings of the image's encoder (see RegistrationOptions::encoders),
+ * by NFRL's strip encoder if set.
+ *
  * @param path location on file system to save image file
  *
  * @throw NFRL::Miscue for invalid path, corrupted image buffer
  */
 void Registrator::saveCroppedRegisteredImageToDisk( const std::string path ) const
 {
-  std::vector<int> compression_params;
-  compression_params.push_back(cv::IMWRITE_PNG_COMPRESSION);
-  compression_params.push_back(9);
+  if( !isOutputRetained( croppedRegisteredImage ) ) {
+    std::string err{"Image not selected for output, cannot save: "};
+    err.append( path );
+    throw NFRL::Miscue( err );
+  }
 
   bool result = false;
   try {
-    cv::Mat img = cv::imdecode( cv::Mat(_vecCroppedRegisteredImage),
-                                cv::IMREAD_UNCHANGED );
-    result = cv::imwrite( path, img );
+    result = _imagery->write( croppedRegisteredImage, _imagery->cropMoving(), path );
   }
   catch( const cv::Exception& ex ) {
     std::string err{"OpenCV cannot save image: '"};
@@ -222,21 +831,25 @@ void Registrator::saveCroppedRegisteredImageToDisk( const std::string path ) con
 /**
  * @brief  Enable the using software the option to save image to disk.
  *
+ * The format is that of the file extension; a PNG is written with the PNG
+ * settings of the image's encoder (see RegistrationOptions::encoders),
+ * by NFRL's strip encoder if set.
+ *
  * @param path location on file system to save image file
  *
  * @throw NFRL::Miscue for invalid path, corrupted image buffer
  */
 void Registrator::saveCroppedFixedImageToDisk( const std::string path ) const
 {
-  std::vector<int> compression_params;
-  compression_params.push_back(cv::IMWRITE_PNG_COMPRESSION);
-  compression_params.push_back(9);
+  if( !isOutputRetained( croppedFixedImage ) ) {
+    std::string err{"Image not selected for output, cannot save: "};
+    err.append( path );
+    throw NFRL::Miscue( err );
+  }
 
   bool result = false;
   try {
-    cv::Mat img = cv::imdecode( cv::Mat(_vecCroppedFixedImage),
-                                cv::IMREAD_UNCHANGED );
-    result = cv::imwrite( path, img );
+    result = _imagery->write( croppedFixedImage, _imagery->cropFixed(), path );
   }
   catch( const cv::Exception& ex ) {
     std::string err{"OpenCV cannot save image: '"};
@@ -520,34 +1133,401 @@ void Registrator::getMetadata( Registrator::RegistrationMetadata &m ) const
 
 
 /**
- * @brief Core method.
- *
- * Prior to registration, the images are padded on all sides with white.
- * This is done to prevent any pixels in the moving image from being "moved"
- * or "registered" outside of the fixed image boundary (else portions of the
- * fingerprint would be "cut off").
+ * @brief Register the two images using the default options.
  *
- * The moving image is translated and rotated to "match" the fixed image.
- * In other words, the fixed image is "fixed" in space and the moving image
- * is "moved" to align with the fixed.
+ * The Moving image is translated and then rotated using bilinear
+ * interpolation; see performRegistration( const RegistrationOptions& ).
+ */
+void Registrator::performRegistration()
+{
+  performRegistration( RegistrationOptions() );
+}
+
+
+/**
+ * @brief Map the NFRL interpolation type to its OpenCV flag.
  *
- * Translation:
- * The first point of the moving image is moved to the first point of the
- * fixed image.
+ * @param interp IN resampling method
  *
- * Rotation:
- * The angle from the horizontal for each segment in each image is calculated.
- * The difference between these angles is the amount of rotation.  The "origin"
- * of the rotation is the first, selected control point of the fixed image.
- * If the angle difference is negative, the rotation is clockwise; if positive,
- * rotation is counterclockwise.
+ * @return OpenCV interpolation flag, bilinear if unrecognized
+ */
+int Registrator::interpolationFlag( Interpolation interp ) const
+{
+  switch( interp )
+  {
+    case nearest : return cv::INTER_NEAREST;
+    case cubic   : return cv::INTER_CUBIC;
+    case linear  :
+    default      : return cv::INTER_LINEAR;
+  }
+}
+
+/**
+ * @brief Whether an output of the last registration can be retrieved.
  *
- * For image padding that results in two images of the same size
- * (width x height):
- * 1. The "target" pad size is based on the sizes of the input images; this
- *  target WxH is then used to calculate the padding for both images resulting
- * in two padded images that are the same size.
- * 2. translate and rotate the MOVING to the FIXED.
+ * @param artifact IN output to check
+ *
+ * @return true if selected for output and the registration completed
+ */
+bool Registrator::isOutputRetained( OutputArtifact artifact ) const
+{
+  return _imagery && ( _imagery->outputs & artifact ) != 0;
+}
+
+
+/**
+ * @brief The registered Moving image cropped to the ROI.
+ *
+ * @return cropped image, shares the registered pixels where possible
+ */
+cv::Mat Registrator::Imagery::cropMoving() const
+{
+  return paddedRegisteredMoving.materialize( cropRegion );
+}
+
+/**
+ * @brief The Fixed image cropped to the ROI, white where the ROI falls
+ *  outside the Fixed image.
+ *
+ * @return cropped image, shares the Fixed pixels where possible
+ */
+cv::Mat Registrator::Imagery::cropFixed() const
+{
+  return paddedFixed.materialize( cropRegion );
+}
+
+/**
+ * @brief Overlay the green, Moving image atop the cyan, Fixed image.
+ *
+ * Outside the stored pixels of both images, both are white and so is the
+ * overlay; only the region of stored pixels is colorized and merged, in a
+ * single pass (see CVops::color_overlay()).
+ *
+ * @return padded, color overlay
+ * @throw NFRL::Miscue OpenCV cannot colorize or merge images
+ */
+cv::Mat Registrator::Imagery::renderColorOverlay() const
+{
+  try {
+    return CVops::color_overlay( paddedRegisteredMoving, paddedFixed );
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"OpenCV cannot merge overlaid images: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+}
+
+/**
+ * @brief Render an output image, or return it if already rendered.
+ *
+ * @param artifact IN OutputArtifact bit
+ *
+ * @return output image
+ * @throw NFRL::Miscue OpenCV cannot render the image
+ */
+cv::Mat Registrator::Imagery::render( const unsigned int artifact ) const
+{
+  auto it = rendered.find( artifact );
+  if( it != rendered.end() )
+    return it->second;
+
+  switch( artifact )
+  {
+    case croppedRegisteredImage      : return cropMoving();
+    case croppedFixedImage           : return cropFixed();
+    case colorOverlaidImage          : return renderColorOverlay();
+    case paddedFixedImage            : return paddedFixed.materialize();
+    case paddedRegisteredMovingImage : return paddedRegisteredMoving.materialize();
+    case overlapBlob                 : return overlap ? overlap->getBlob() : cv::Mat();
+    default                          : return cv::Mat();
+  }
+}
+
+/**
+ * @brief Render an output image once and retain it.
+ *
+ * @param artifact IN OutputArtifact bit
+ *
+ * @return retained output image
+ * @throw NFRL::Miscue OpenCV cannot render the image
+ */
+const cv::Mat& Registrator::Imagery::image( const unsigned int artifact )
+{
+  auto it = rendered.find( artifact );
+  if( it == rendered.end() )
+    it = rendered.emplace( artifact, render( artifact ) ).first;
+  return it->second;
+}
+
+/**
+ * @param artifact IN OutputArtifact bit
+ *
+ * @return width and height of the output image
+ */
+cv::Size Registrator::Imagery::imageSize( const unsigned int artifact ) const
+{
+  switch( artifact )
+  {
+    case croppedRegisteredImage :
+    case croppedFixedImage      : return cropRegion.size();
+    default                     : return canvasSize;
+  }
+}
+
+/**
+ * @param artifact IN OutputArtifact bit
+ *
+ * @return 3 for the color overlay, else 1
+ */
+int Registrator::Imagery::imageChannels( const unsigned int artifact ) const
+{
+  return ( artifact == colorOverlaidImage ) ? 3 : 1;
+}
+
+/**
+ * @param artifact IN OutputArtifact
+ *
+ * @return encoder settings of the output, PNG with OpenCV's defaults if not
+ *         set by the caller
+ */
+Registrator::EncoderSettings
+Registrator::Imagery::encoder( const unsigned int artifact ) const
+{
+  auto it = encoders.find( artifact );
+  return ( it == encoders.end() ) ? EncoderSettings() : it->second;
+}
+
+/**
+ * @brief Encode an output image per its encoder settings.
+ *
+ * The blob is binary (0 or 255), so as PNG it may be encoded as a 1-bit PNG
+ * (see EncoderSettings::pngBilevel).
+ *
+ * @param artifact IN OutputArtifact of the image
+ * @param img IN image to encode
+ * @param vec OUT byte-stream
+ * @param errPrefix IN exception message on failure
+ *
+ * @throw NFRL::Miscue OpenCV cannot encode the image
+ */
+void Registrator::Imagery::encode( const unsigned int artifact,
+                                   const cv::Mat &img,
+                                   std::vector<uint8_t> &vec,
+                                   const std::string &errPrefix ) const
+{
+  const EncoderSettings settings = encoder( artifact );
+  const bool bilevel = settings.pngBilevel && ( artifact == overlapBlob );
+  try {
+    switch( settings.format )
+    {
+      case pnmFormat :
+        CVops::encode_pnm( img, vec );
+        break;
+      case bmpFormat :
+        cv::imencode( ".bmp", img, vec );
+        break;
+      case pngFormat :
+      default        :
+        if( settings.parallelPng )
+          stripEncoder( settings ).encode( img, vec, bilevel );
+        else
+          cv::imencode( ".png", img, vec, pngParams( settings, bilevel ) );
+        break;
+    }
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{errPrefix};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+  catch( const NFRL::Miscue& ex ) {
+    std::string err{errPrefix};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+}
+
+/**
+ * @brief Save an output image to disk, in the format of the file extension.
+ *
+ * If the extension names the format of the image's encoder, the file holds
+ * the byte-stream of encode(), e.g., by NFRL's strip encoder if set.
+ * Otherwise OpenCV writes the file, a PNG with the PNG settings of the
+ * encoder.
+ *
+ * @param artifact IN OutputArtifact of the image
+ * @param img IN image to save
+ * @param path IN file path
+ *
+ * @return true if the image is written
+ * @throw cv::Exception OpenCV cannot encode the image
+ * @throw NFRL::Miscue the encoder cannot encode the image
+ */
+bool Registrator::Imagery::write( const unsigned int artifact,
+                                  const cv::Mat &img,
+                                  const std::string &path ) const
+{
+  const EncoderSettings settings = encoder( artifact );
+  std::string ext = path.substr( std::min( path.size(), path.rfind( '.' ) ) );
+  std::transform( ext.begin(), ext.end(), ext.begin(), ::tolower );
+  bool encoderFormat{false};
+  switch( settings.format )
+  {
+    case pnmFormat :
+      encoderFormat = ( ext == ".pgm" || ext == ".ppm" || ext == ".pnm" );
+      break;
+    case bmpFormat :
+      encoderFormat = ( ext == ".bmp" || ext == ".dib" );
+      break;
+    case pngFormat :
+    default        :
+      encoderFormat = ( ext == ".png" );
+      break;
+  }
+  if( !encoderFormat )
+  {
+    if( ext == ".png" )
+      return cv::imwrite( path, img, pngParams( settings ) );
+    return cv::imwrite( path, img );
+  }
+
+  std::vector<uint8_t> bytes;
+  encode( artifact, img, bytes, "cannot encode image: " );
+  std::ofstream ofs( path, std::ios::binary );
+  ofs.write( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+  return ofs.good();
+}
+
+/**
+ * @brief NFRL strip PNG encoder of encoder settings, on the thread budget
+ *  of the registration.
+ *
+ * As OpenCV, the default strategy is RLE and the default level is 1 with the
+ * Sub filter; with a level set, the default filter is chosen per row, as
+ * libpng does.
+ *
+ * @param settings IN encoder settings
+ *
+ * @return strip encoder
+ */
+NFRL::StripPngEncoder
+Registrator::Imagery::stripEncoder( const EncoderSettings &settings ) const
+{
+  int strategy;
+  switch( settings.pngStrategy )
+  {
+    case filteredStrategy    : strategy = Z_FILTERED; break;
+    case huffmanOnlyStrategy : strategy = Z_HUFFMAN_ONLY; break;
+    case rleStrategy         : strategy = Z_RLE; break;
+    case fixedStrategy       : strategy = Z_FIXED; break;
+    case zlibDefaultStrategy : strategy = Z_DEFAULT_STRATEGY; break;
+    case defaultStrategy     :
+    default                  : strategy = Z_RLE; break;
+  }
+  int filter;
+  switch( settings.pngFilter )
+  {
+    case noFilter      : filter = 0; break;
+    case subFilter     : filter = 1; break;
+    case upFilter      : filter = 2; break;
+    case averageFilter : filter = 3; break;
+    case paethFilter   : filter = 4; break;
+    case allFilters    : filter = NFRL::StripPngEncoder::ADAPTIVE_FILTER; break;
+    case defaultFilter :
+    default            :
+      filter = ( settings.pngLevel < 0 ) ? 1
+               : NFRL::StripPngEncoder::ADAPTIVE_FILTER;
+      break;
+  }
+  return NFRL::StripPngEncoder( settings.pngLevel < 0 ? 1 : settings.pngLevel,
+                                strategy, filter, threads );
+}
+
+/**
+ * @brief OpenCV PNG encoder parameters of encoder settings.
+ *
+ * Only settings that differ from OpenCV's defaults are passed, so the
+ * default settings encode exactly as imencode() without parameters.
+ *
+ * @param settings IN encoder settings
+ * @param bilevel IN encode a binary (0 or 255) image as a 1-bit PNG
+ *
+ * @return imencode() / imwrite() parameters
+ */
+std::vector<int> Registrator::Imagery::pngParams( const EncoderSettings &settings,
+                                                  const bool bilevel )
+{
+  std::vector<int> params;
+  if( bilevel )
+    params.insert( params.end(), { cv::IMWRITE_PNG_BILEVEL, 1 } );
+  if( settings.pngLevel >= 0 )
+  {
+    params.insert( params.end(), { cv::IMWRITE_PNG_COMPRESSION,
+                                   std::min( settings.pngLevel, 9 ) } );
+  }
+  int strategy{-1};
+  switch( settings.pngStrategy )
+  {
+    case filteredStrategy    : strategy = cv::IMWRITE_PNG_STRATEGY_FILTERED; break;
+    case huffmanOnlyStrategy : strategy = cv::IMWRITE_PNG_STRATEGY_HUFFMAN_ONLY; break;
+    case rleStrategy         : strategy = cv::IMWRITE_PNG_STRATEGY_RLE; break;
+    case fixedStrategy       : strategy = cv::IMWRITE_PNG_STRATEGY_FIXED; break;
+    case zlibDefaultStrategy : strategy = cv::IMWRITE_PNG_STRATEGY_DEFAULT; break;
+    case defaultStrategy     :
+    default                  : break;
+  }
+  if( strategy >= 0 )
+    params.insert( params.end(), { cv::IMWRITE_PNG_STRATEGY, strategy } );
+#if CV_VERSION_MAJOR > 4 || ( CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 11 )
+  int filter{-1};
+  switch( settings.pngFilter )
+  {
+    case noFilter      : filter = cv::IMWRITE_PNG_FILTER_NONE; break;
+    case subFilter     : filter = cv::IMWRITE_PNG_FILTER_SUB; break;
+    case upFilter      : filter = cv::IMWRITE_PNG_FILTER_UP; break;
+    case averageFilter : filter = cv::IMWRITE_PNG_FILTER_AVG; break;
+    case paethFilter   : filter = cv::IMWRITE_PNG_FILTER_PAETH; break;
+    case allFilters    : filter = cv::IMWRITE_PNG_ALL_FILTERS; break;
+    case defaultFilter :
+    default            : break;
+  }
+  if( filter >= 0 )
+    params.insert( params.end(), { cv::IMWRITE_PNG_FILTER, filter } );
+#endif
+  return params;
+}
+
+
+/**
+ * @brief Core method.
+ *
+ * Prior to registration, the images are padded on all sides with white.
+ * This is done to prevent any pixels in the moving image from being "moved"
+ * or "registered" outside of the fixed image boundary (else portions of the
+ * fingerprint would be "cut off").
+ *
+ * The moving image is translated and rotated to "match" the fixed image.
+ * In other words, the fixed image is "fixed" in space and the moving image
+ * is "moved" to align with the fixed.
+ *
+ * Translation:
+ * The first point of the moving image is moved to the first point of the
+ * fixed image.
+ *
+ * Rotation:
+ * The angle from the horizontal for each segment in each image is calculated.
+ * The difference between these angles is the amount of rotation.  The "origin"
+ * of the rotation is the first, selected control point of the fixed image.
+ * If the angle difference is negative, the rotation is clockwise; if positive,
+ * rotation is counterclockwise.
+ *
+ * For image padding that results in two images of the same size
+ * (width x height):
+ * 1. The "target" pad size is based on the sizes of the input images; this
+ *  target WxH is then used to calculate the padding for both images resulting
+ * in two padded images that are the same size.
+ * 2. translate and rotate the MOVING to the FIXED.
  *
  * Prior to calling this function, caller MUST update the corresponding control
  * points and metadata private variables that are passed by reference.  The
@@ -565,21 +1545,29 @@ void Registrator::getMetadata( Registrator::RegistrationMetadata &m ) const
  * that image is converted to grayscale(8-bits per pixel); the registration metadata
  * is updated to indicate the conversion.
  *
+ * The Moving image is warped per the caller's options: either translated
+ * onto an interim canvas (a whole-pixel placement) and then rotated, or
+ * warped once by the composition of the two matrices.  In both cases the translation and rotation matrices are
+ * reported in the registration metadata as separate transforms.
+ *
+ * No output image is encoded here: each output selected at construction is
+ * generated on its first retrieval, see OutputArtifact.
+ *
+ * @param options IN transform mode and interpolation for this registration
+ *
  * @throw NFRL::Miscue image control-points identical
  * @throw NFRL::Miscue corresponding points (vector) count not-equal to 8
  * @throw NFRL::Miscue OpenCV cannot decode image
  * @throw NFRL::Miscue OpenCV cannot pad image
  * @throw NFRL::Miscue padded images not same size
- * @throw NFRL::Miscue OpenCV cannot colorize padded, fixed image
  * @throw NFRL::Miscue OpenCV cannot perform translation
  * @throw NFRL::Miscue OpenCV cannot perform rotation
- * @throw NFRL::Miscue OpenCV cannot colorize padded-translated-rotated image
- * @throw NFRL::Miscue OpenCV cannot merge overlaid images
+ * @throw NFRL::Miscue OpenCV cannot perform composed translation-rotation
  * @throw NFRL::Miscue Registered images overlap region is empty
  * @throw NFRL::Miscue Registered images overlap region does not meet width threshold
  * @throw NFRL::Miscue Registered images overlap region does not meet height threshold
  */
-void Registrator::performRegistration()
+void Registrator::performRegistration( const RegistrationOptions &options )
 {
   if( _correspondingPoints.size() != 8 )
   {
@@ -598,21 +1586,128 @@ void Registrator::performRegistration()
   if( pt2 == pt4 ) {
     throw NFRL::Miscue( "Fixed image control-points identical, cannot continue" );
   }
+
+  // Discard outputs of any previous registration by this object.
+  _imagery.reset();
+  _vecCroppedRegisteredImage.clear();
+  _vecCroppedFixedImage.clear();
+  _vecColorOverlaidRegisteredImages.clear();
+  _vecPaddedFixedImg.clear();
+  _vecPaddedRegisteredMovingImg.clear();
+  _vecPngBlob.clear();
+  std::unique_ptr<Imagery> imagery( new Imagery() );
+  imagery->outputs = _outputs;
+  for( const auto &encoder : options.encoders )
+    imagery->encoders[encoder.first] = encoder.second;
+  // The palette overlay is a PNG.
+  imagery->paletteOverlay = options.paletteOverlay &&
+    imagery->encoder( colorOverlaidImage ).format == pngFormat;
+  if( options.croppedOutputsOnly )
+  {
+    imagery->outputs &= ( croppedRegisteredImage | croppedFixedImage );
+  }
+  _metadata.push_back( "Output encoders:" );
+  for( const OutputArtifact artifact : { croppedRegisteredImage,
+                                         croppedFixedImage, colorOverlaidImage,
+                                         paddedFixedImage,
+                                         paddedRegisteredMovingImage,
+                                         overlapBlob } )
+  {
+    if( !( imagery->outputs & artifact ) )
+      continue;
+    std::string s = imagery->encoder( artifact ).to_s();
+    if( artifact == colorOverlaidImage && imagery->paletteOverlay )
+      s += ", 8-bit palette";
+    else if( artifact == overlapBlob &&
+             imagery->encoder( artifact ).format == pngFormat )
+      s += ", 1-bit";
+    _metadata.push_back( "  " + std::string( artifact_name( artifact ) ) +
+                         ": " + s );
+  }
   
+  // Decode both images and, if trimming, find the foreground of each: two
+  // independent chains of tasks.
   cv::Mat img1, img2;
+  cv::Rect foreground1, foreground2;
+  const int threads = NFRL::TaskGraph::threadBudget( options.threads );
+  imagery->threads = threads;
+  _metadata.push_back( "Thread budget: " + std::to_string( threads ) );
+  auto findForeground = []( const cv::Mat &img, cv::Rect &foreground )
+  {
+    try {
+      foreground = CVops::foreground_rect( img, TRIM_MARGIN );
+    }
+    catch( const cv::Exception& ex ) {
+      std::string err{"OpenCV cannot trim image: "};
+      err.append( ex.what() );
+      throw NFRL::Miscue( err );
+    }
+  };
   try {
-    img1 = cv::imdecode( cv::Mat(_imgMoving), cv::IMREAD_GRAYSCALE );
-    if( img1.channels() > 1 )
+    NFRL::TaskGraph inputs;
+    const int decodeMoving = inputs.add( [&]()
     {
-      registrationMetadata.convertToGrayscale.img1 = true;
-    }
-    registrationMetadata.srcMovingImgSize.set( img1.cols, img1.rows );
-
-    img2 = cv::imdecode( cv::Mat(_imgFixed), cv::IMREAD_GRAYSCALE );
-    if( img2.channels() > 1 )
+      if( !_rawMoving.data )
+      {
+        img1 = cv::imdecode( cv::Mat(*_imgMoving), cv::IMREAD_GRAYSCALE );
+        if( img1.channels() > 1 )
+        {
+          registrationMetadata.convertToGrayscale.img1 = true;
+        }
+      }
+      else
+      {
+        img1 = CVops::grayscale_image( _rawMoving.data.get(),
+                                       _rawMoving.width, _rawMoving.height,
+                                       _rawMoving.stride, _rawMoving.channels );
+        registrationMetadata.convertToGrayscale.img1 = _preparedMoving
+          ? _preparedMoving->_converted : _rawMoving.channels > 1;
+      }
+    } );
+    const int decodeFixed = inputs.add( [&]()
+    {
+      if( !_rawFixed.data )
+      {
+        img2 = cv::imdecode( cv::Mat(*_imgFixed), cv::IMREAD_GRAYSCALE );
+        if( img2.channels() > 1 )
+        {
+          registrationMetadata.convertToGrayscale.img2 = true;
+        }
+      }
+      else
+      {
+        img2 = CVops::grayscale_image( _rawFixed.data.get(),
+                                       _rawFixed.width, _rawFixed.height,
+                                       _rawFixed.stride, _rawFixed.channels );
+        registrationMetadata.convertToGrayscale.img2 = _preparedFixed
+          ? _preparedFixed->_converted : _rawFixed.channels > 1;
+      }
+    } );
+    if( options.trimSourceMargins )
     {
-      registrationMetadata.convertToGrayscale.img2 = true;
+      if( !_preparedMoving )
+      {
+        inputs.add( [&]() { findForeground( img1, foreground1 ); },
+                    { decodeMoving } );
+      }
+      else
+      {
+        const std::array<int, 4> &fg = _preparedMoving->_foreground;
+        foreground1 = cv::Rect( fg[0], fg[1], fg[2], fg[3] );
+      }
+      if( !_preparedFixed )
+      {
+        inputs.add( [&]() { findForeground( img2, foreground2 ); },
+                    { decodeFixed } );
+      }
+      else
+      {
+        const std::array<int, 4> &fg = _preparedFixed->_foreground;
+        foreground2 = cv::Rect( fg[0], fg[1], fg[2], fg[3] );
+      }
     }
+    inputs.run( threads );
+    registrationMetadata.srcMovingImgSize.set( img1.cols, img1.rows );
     registrationMetadata.srcFixedImgSize.set( img2.cols, img2.rows );
 
     _metadata.push_back( "Source images dimensions:" );
@@ -638,6 +1733,26 @@ void Registrator::performRegistration()
   _metadata.push_back( cpRaw );
 
 
+  // Prep for rotation.  The angle is needed now to size a tight canvas.
+  // rp := rotation points
+  cv::Point2f rp1 =
+              cv::Point2f( static_cast<float>(_correspondingPoints[0]),
+                           static_cast<float>(_correspondingPoints[1]) );
+  cv::Point2f rp2 =
+              cv::Point2f( static_cast<float>(_correspondingPoints[4]),
+                           static_cast<float>(_correspondingPoints[5]) );
+  NFRL::PointsOnImage poi1(rp1, rp2);
+
+  cv::Point2f rp3 =
+              cv::Point2f( static_cast<float>(_correspondingPoints[2]),
+                           static_cast<float>(_correspondingPoints[3]) );
+  cv::Point2f rp4 =
+              cv::Point2f( static_cast<float>(_correspondingPoints[6]),
+                           static_cast<float>(_correspondingPoints[7]) );
+  NFRL::PointsOnImage poi2(rp3, rp4);
+
+  double angleDiffDegrees = poi2.angleDegrees - poi1.angleDegrees;
+
   // ************ START PADDING **************
   // To ensure the final, registered, Moving image does not have any portion
   // of the ridge structure cut off, both images are padded prior to the
@@ -651,19 +1766,63 @@ void Registrator::performRegistration()
   // The "target" pad size is based on the sizes of the input images; this
   // target WxH is then used to calculate the padding for both images resulting
   // in two padded images that are the same size.
-  cv::Mat paddedMovingImg, paddedFixedImg;
+  // For the tight-canvas policy, the target is instead the bounding box of the
+  // Fixed image and the footprint of the registered Moving image (in the Fixed
+  // image frame); the left and top padding are the offsets of that box.  The
+  // two-step warp rotates the translated Moving image within the canvas, so
+  // for it the box also holds the translated image.
+  // Virtual padding always translates and rotates in one resample; cropped
+  // outputs alone never need the padded canvas.  The fixed-point warp is
+  // only implemented as that single resample of the footprint (by
+  // CVops::warp_affine() and the tiled engine); the stored-canvas path calls
+  // warpAffine() directly, once per step, so the fixed-point warp implies
+  // virtual padding.
+  const bool virtualPadding = options.virtualPadding ||
+                              options.croppedOutputsOnly ||
+                              options.tiledEngine ||
+                              options.warpKernel == fixedPointWarp;
+  const bool sequentialWarp = !virtualPadding &&
+                              options.transformMode != composed;
+  // Translated (unrotated) Moving image in the Fixed image frame; the
+  // two-step warp holds it on the canvas before rotating it.
+  const cv::Rect translatedMoving( pt2 - pt1, img1.size() );
+  int targetPadWidth, targetPadHeight;
     {
       _padDiffMoving.reset();
       _padDiffFixed.reset();
 
-      int targetPadWidth, targetPadHeight;
-      targetPadWidth =  img2.cols + ( 2 * img1.cols );
-      targetPadHeight = img2.rows + ( 2 * img1.rows );
+      if( options.paddingPolicy == tightCanvas )
+      {
+        float translationData[6] = {
+          1, 0, static_cast<float>(pt2.x - pt1.x),
+          0, 1, static_cast<float>(pt2.y - pt1.y) };
+        cv::Mat footprintTransform = CVops::compose_affine_transforms(
+                cv::Mat( 2, 3, CV_32F, translationData ),
+                cv::getRotationMatrix2D( rp3, angleDiffDegrees, 1.0 ) );
+        cv::Rect footprint =
+                CVops::transformed_bounding_rect( img1.size(),
+                                                  footprintTransform,
+                                                  WARP_SUPPORT_MARGIN );
+        cv::Rect canvas = footprint | cv::Rect( 0, 0, img2.cols, img2.rows );
+        if( sequentialWarp )
+        {
+          canvas |= translatedMoving;
+        }
+
+        targetPadWidth =  canvas.width;
+        targetPadHeight = canvas.height;
+        _padDiffMoving.top = -canvas.y;
+        _padDiffMoving.left = -canvas.x;
+      }
+      else
+      {
+        targetPadWidth =  img2.cols + ( 2 * img1.cols );
+        targetPadHeight = img2.rows + ( 2 * img1.rows );
+        _padDiffMoving.top = img1.rows;
+        _padDiffMoving.left = img1.cols;
+      }
 
-      _padDiffMoving.top = img1.rows;
       _padDiffFixed.top = _padDiffMoving.top;  // padding top MUST be same
-
-      _padDiffMoving.left = img1.cols;
       _padDiffFixed.left = _padDiffMoving.left;  // padding left MUST be same
 
       _padDiffMoving.bot = targetPadHeight - img1.rows - _padDiffMoving.top;
@@ -684,53 +1843,78 @@ void Registrator::performRegistration()
     }
   // ************ END PADDING **************
 
-  try {
-    cv::copyMakeBorder( img1, paddedMovingImg,
-                        _padDiffMoving.top, _padDiffMoving.bot,
-                        _padDiffMoving.left, _padDiffMoving.right,
-                        cv::BORDER_CONSTANT, cv::Scalar::all(255) );
-    std::vector<int> param(1);
-    param[0] = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
-    cv::copyMakeBorder( img2, paddedFixedImg,
-                        _padDiffFixed.top, _padDiffFixed.bot,
-                        _padDiffFixed.left, _padDiffFixed.right,
-                        cv::BORDER_CONSTANT, cv::Scalar::all(255) );
-  }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot pad image: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
-  }
-
-  if( (paddedMovingImg.cols == paddedFixedImg.cols) &&
-      (paddedMovingImg.rows == paddedFixedImg.rows) )
+  // Optionally trim the light margins of the sources to their foreground
+  // (found with the decode, above).  The canvas and padding are those of the
+  // whole images: each trimmed image is placed on the canvas at the padding
+  // plus its trim offset, so the transforms and every reported coordinate
+  // stay in the original frame.
+  cv::Point trimMoving( 0, 0 ), trimFixed( 0, 0 );
+  if( options.trimSourceMargins )
   {
-    registrationMetadata.paddedImgSize.set( paddedFixedImg.cols,
-                                            paddedFixedImg.rows );
-    _metadata.push_back( "Padded images are SAME size:" );
-    _metadata.push_back( "New PADDED moving img dimensions: "
-                         + std::to_string( paddedMovingImg.cols ) + "x"
-                         + std::to_string( paddedMovingImg.rows ) + " [WxH]" );
-    _metadata.push_back( "New PADDED fixed img dimensions:  "
-                         + std::to_string( paddedFixedImg.cols ) + "x"
-                         + std::to_string( paddedFixedImg.rows ) + " [WxH]" );
-  }
-  else {
-    throw NFRL::Miscue( "Padded images not same size" );
-  }
-
-  // Convert padded fixed image gray to BGR and then cyan.
-  cv::Mat colorPaddedFixedImg( paddedFixedImg.size(), CV_8UC3,
-                               cv::Scalar(0, 0, 0) );
-  try {
-    cv::cvtColor( paddedFixedImg, colorPaddedFixedImg, cv::COLOR_GRAY2RGB );
+    img1 = img1( foreground1 );
+    img2 = img2( foreground2 );
+    trimMoving = foreground1.tl();
+    trimFixed = foreground2.tl();
+    _metadata.push_back( "Source images trimmed to foreground:" );
+    _metadata.push_back( "  Moving img: " + std::to_string( foreground1.width ) +
+                         "x" + std::to_string( foreground1.height ) +
+                         " [WxH] at (" + std::to_string( foreground1.x ) + "," +
+                         std::to_string( foreground1.y ) + ")" );
+    _metadata.push_back( "  Fixed img:  " + std::to_string( foreground2.width ) +
+                         "x" + std::to_string( foreground2.height ) +
+                         " [WxH] at (" + std::to_string( foreground2.x ) + "," +
+                         std::to_string( foreground2.y ) + ")" );
   }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot colorize padded, fixed image: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
+  const cv::Point movingOrigin( _padDiffMoving.left + trimMoving.x,
+                                _padDiffMoving.top + trimMoving.y );
+  const cv::Point fixedOrigin( _padDiffFixed.left + trimFixed.x,
+                               _padDiffFixed.top + trimFixed.y );
+
+  // The Moving image is not padded here: it is placed onto the canvas at the
+  // padding offset by the same resample that translates it.
+  // For virtual padding, the Fixed image is not padded either.  Its padding
+  // is only an offset within the canvas; padding pixels read as white
+  // without being stored.
+  const cv::Size canvasSize( targetPadWidth, targetPadHeight );
+  // Stored padding of the Fixed image is a task that runs alongside the
+  // warp of the Moving image (see below).
+  auto padFixed = [&]()
+  {
+    cv::Mat paddedFixedImg;
+    try {
+      cv::copyMakeBorder( img2, paddedFixedImg,
+                          fixedOrigin.y,
+                          canvasSize.height - img2.rows - fixedOrigin.y,
+                          fixedOrigin.x,
+                          canvasSize.width - img2.cols - fixedOrigin.x,
+                          cv::BORDER_CONSTANT, cv::Scalar::all(255) );
+    }
+    catch( const cv::Exception& ex ) {
+      std::string err{"OpenCV cannot pad image: "};
+      err.append( ex.what() );
+      throw NFRL::Miscue( err );
+    }
+    imagery->paddedFixed =
+      NFRL::VirtualPaddedImage( paddedFixedImg, cv::Point( 0, 0 ),
+                                paddedFixedImg.size() );
+  };
+  if( virtualPadding )
+  {
+    imagery->paddedFixed =
+      NFRL::VirtualPaddedImage( img2, fixedOrigin, canvasSize );
   }
-  colorPaddedFixedImg += cv::Scalar(255,0,255);  // cyan
+  const NFRL::VirtualPaddedImage &paddedFixed = imagery->paddedFixed;
+
+  // Both padded images are canvasSize; checked once the Fixed is padded.
+  registrationMetadata.paddedImgSize.set( canvasSize.width,
+                                          canvasSize.height );
+  _metadata.push_back( "Padded images are SAME size:" );
+  _metadata.push_back( "New PADDED moving img dimensions: "
+                       + std::to_string( canvasSize.width ) + "x"
+                       + std::to_string( canvasSize.height ) + " [WxH]" );
+  _metadata.push_back( "New PADDED fixed img dimensions:  "
+                       + std::to_string( canvasSize.width ) + "x"
+                       + std::to_string( canvasSize.height ) + " [WxH]" );
 
   // Save the Fixed image input point coordinates with padding as the
   // control points for registration metadata.  Since the Fixed image by
@@ -796,42 +1980,17 @@ void Registrator::performRegistration()
   _metadata.push_back( "TRANSLATION MATRIX:\n" );
   _metadata.push_back( strMatrix );
 
-  // translate
-  cv::Mat translatedMovingImg( paddedMovingImg.size(), CV_8UC3,
-                               cv::Scalar(0, 0, 0) );
-  try {
-    cv::warpAffine( paddedMovingImg, translatedMovingImg,
-                    translateMatrix, translatedMovingImg.size(),
-                    cv::INTER_LINEAR, cv::BORDER_CONSTANT,
-                    cv::Scalar(255,255,255) );
-  }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot perform translation: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
-  }
+  // Same translation, plus the padding (and trim) offset that places the
+  // (unpadded) Moving image onto the canvas.
+  float placedTranslationData[6] = {
+    1, 0, tx + static_cast<float>(movingOrigin.x),
+    0, 1, ty + static_cast<float>(movingOrigin.y) };
+  cv::Mat placedTranslateMatrix( 2, 3, CV_32F, placedTranslationData );
 
   _metadata.push_back( "\n  ROTATE" );
 
-  // Prep for rotation.
-  // rp := rotation points
-  cv::Point2f rp1 =
-              cv::Point2f( static_cast<float>(_correspondingPoints[0]),
-                           static_cast<float>(_correspondingPoints[1]) );
-  cv::Point2f rp2 =
-              cv::Point2f( static_cast<float>(_correspondingPoints[4]),
-                           static_cast<float>(_correspondingPoints[5]) );
-  NFRL::PointsOnImage poi1(rp1, rp2);
   _metadata.push_back( "Corresponding Points Pair #1 SAME (moving) image: " +
                         poi1.to_s("moving") );
-
-  cv::Point2f rp3 =
-              cv::Point2f( static_cast<float>(_correspondingPoints[2]),
-                           static_cast<float>(_correspondingPoints[3]) );
-  cv::Point2f rp4 =
-              cv::Point2f( static_cast<float>(_correspondingPoints[6]),
-                           static_cast<float>(_correspondingPoints[7]) );
-  NFRL::PointsOnImage poi2(rp3, rp4);
   _metadata.push_back( "Corresponding Points Pair #2 SAME (fixed) image: " +
                         poi2.to_s("fixed") + "\n");
 
@@ -842,7 +2001,6 @@ void Registrator::performRegistration()
 
   // Prep for calculation of the rotation matrix.
   double rotationScale{1.0};
-  double angleDiffDegrees = poi2.angleDegrees - poi1.angleDegrees;
   registrationMetadata.angleDiffDegrees = angleDiffDegrees;
 
   // Output angle data to _metadata for logging.
@@ -876,61 +2034,251 @@ void Registrator::performRegistration()
   _metadata.push_back( "ROTATION MATRIX:\n" );
   _metadata.push_back( strMatrix );
 
-  // rotate
-  cv::Mat paddedRegisteredMovingImg( translatedMovingImg.size(),
-                                     CV_8UC3, cv::Scalar(0, 0, 0) );
-  try {
-    cv::warpAffine( translatedMovingImg, paddedRegisteredMovingImg,
-                    rotateMatrix, translatedMovingImg.size(),
-                    cv::INTER_LINEAR, cv::BORDER_CONSTANT,
-                    cv::Scalar(255,255,255) );
-  }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot perform rotation: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
-  }
-
-  cv::Mat colorPaddedRegisteredMovingImg( translatedMovingImg.size(),
-                                          CV_8UC3, cv::Scalar(0, 0, 0) );
-  try {
-    cv::cvtColor( paddedRegisteredMovingImg,
-                  colorPaddedRegisteredMovingImg,
-                  cv::COLOR_GRAY2RGB );
-  }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot colorize padded-translated-rotated image: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
+  const int interpolation = interpolationFlag( options.interpolation );
+  // Identity, whole-pixel translations and right angles need no resample;
+  // each warp is classified once, and the class chooses its code path.
+  std::string transformClass;
+  const bool fixedPoint = ( options.warpKernel == fixedPointWarp );
+  NFRL::TiledEngine engine( options.tileSize, fixedPoint );
+  if( virtualPadding )
+  {
+    // The translation only places the Moving image on the canvas (integer
+    // offset), so translation and rotation are applied in one resample of the
+    // source pixels, and only the registered footprint is stored.
+    NFRL::VirtualPaddedImage paddedMoving( img1, movingOrigin, canvasSize );
+    const cv::Mat movingTransform =
+      CVops::compose_affine_transforms( translateMatrix, rotateMatrix );
+    if( options.tiledEngine )
+    {
+      // Warp, Otsu thresholds, overlay and overlap in two passes of tiles.
+      const bool renderOverlay = ( imagery->outputs & colorOverlaidImage ) &&
+                                 !imagery->paletteOverlay;
+      engine.run( paddedMoving, movingTransform, interpolation,
+                  WARP_SUPPORT_MARGIN, imagery->paddedFixed, renderOverlay );
+      imagery->paddedRegisteredMoving = engine.registeredMoving();
+      transformClass = CVops::transform_class_name( engine.transformClass() );
+      if( renderOverlay )
+        imagery->rendered[colorOverlaidImage] = engine.overlay();
+      _metadata.push_back( engine.to_s() );
+    }
+    else
+    {
+      if( fixedPoint )
+        _metadata.push_back( "Warp: NFRL fixed-point" );
+      try {
+        CVops::TransformClass kind;
+        imagery->paddedRegisteredMoving =
+          CVops::warp_affine( paddedMoving, movingTransform, interpolation,
+                              WARP_SUPPORT_MARGIN, kind, fixedPoint );
+        transformClass = CVops::transform_class_name( kind );
+      }
+      catch( const cv::Exception& ex ) {
+        std::string err{"OpenCV cannot perform composed translation-rotation: "};
+        err.append( ex.what() );
+        throw NFRL::Miscue( err );
+      }
+    }
   }
-  colorPaddedRegisteredMovingImg += cv::Scalar(0,255,0);  // green
-
+  else
+  {
+    // The rotation of the two-step warp reads only the translated image, so
+    // any part of it clipped by the canvas would be rotated in as white.
+    // Every canvas holds it whole; then the registered pixels inside the
+    // footprint are those of the legacy canvas, offset by its padding.
+    if( sequentialWarp )
+    {
+      const cv::Rect placed = translatedMoving +
+        cv::Point( _padDiffMoving.left, _padDiffMoving.top );
+      if( ( placed & cv::Rect( cv::Point( 0, 0 ), canvasSize ) ) != placed )
+      {
+        throw NFRL::Miscue( "Canvas clips the translated Moving image" );
+      }
+    }
+    cv::Mat composedMatrix;
+    if( options.transformMode == composed )
+    {
+      composedMatrix = CVops::compose_affine_transforms( placedTranslateMatrix,
+                                                         rotateMatrix );
+      strMatrix = CVops::rotation_matrix_to_s( composedMatrix );
+      _metadata.push_back( "COMPOSED MATRIX (rotation x translation):\n" );
+      _metadata.push_back( strMatrix );
+    }
 
-  // Overlay the green, Moving image atop the cyan, Fixed image.
-  cv::Mat colorOverlaidRegisteredImages(
-          paddedRegisteredMovingImg.size(), CV_8UC3,
-          cv::Scalar(0, 0, 0) );
-  try {
-    cv::addWeighted( colorPaddedRegisteredMovingImg, 0.5,
-                     colorPaddedFixedImg, 0.5, 0.0,
-                     colorOverlaidRegisteredImages );
+    // The Fixed image is padded while the Moving image is warped.
+    NFRL::TaskGraph warp;
+    warp.add( padFixed );
+    warp.add( [&]()
+    {
+      // Allocated by the placement or warp, the type of the Moving image.
+      cv::Mat paddedRegisteredMovingImg;
+      if( options.transformMode == composed )
+      {
+        // Place, translate, and rotate in a single resample of the Moving image.
+        try {
+          int rotateCode;
+          cv::Point offset;
+          const CVops::TransformClass kind = CVops::classify_transform(
+            composedMatrix, img1.size(), rotateCode, offset );
+          transformClass = CVops::transform_class_name( kind );
+          if( !CVops::place_exactly( img1, kind, rotateCode, offset,
+                                     canvasSize, cv::Scalar(255,255,255),
+                                     paddedRegisteredMovingImg ) )
+          {
+            cv::warpAffine( img1, paddedRegisteredMovingImg,
+                            composedMatrix, canvasSize,
+                            interpolation, cv::BORDER_CONSTANT,
+                            cv::Scalar(255,255,255) );
+          }
+        }
+        catch( const cv::Exception& ex ) {
+          std::string err{"OpenCV cannot perform composed translation-rotation: "};
+          err.append( ex.what() );
+          throw NFRL::Miscue( err );
+        }
+      }
+      else
+      {
+        // translate; the integer translation copies pixels exactly, so it is
+        // a placement rather than a resample
+        cv::Mat translatedMovingImg;
+        try {
+          int rotateCode;
+          cv::Point offset;
+          const CVops::TransformClass kind = CVops::classify_transform(
+            placedTranslateMatrix, img1.size(), rotateCode, offset );
+          transformClass = CVops::transform_class_name( kind );
+          if( !CVops::place_exactly( img1, kind, rotateCode, offset,
+                                     canvasSize, cv::Scalar(255,255,255),
+                                     translatedMovingImg ) )
+          {
+            cv::warpAffine( img1, translatedMovingImg,
+                            placedTranslateMatrix, canvasSize,
+                            interpolation, cv::BORDER_CONSTANT,
+                            cv::Scalar(255,255,255) );
+          }
+        }
+        catch( const cv::Exception& ex ) {
+          std::string err{"OpenCV cannot perform translation: "};
+          err.append( ex.what() );
+          throw NFRL::Miscue( err );
+        }
+
+        // rotate; no resample for 0 or multiples of 90 degrees
+        try {
+          int rotateCode;
+          cv::Point offset;
+          const CVops::TransformClass kind = CVops::classify_transform(
+            rotateMatrix, translatedMovingImg.size(), rotateCode, offset );
+          transformClass += std::string( ", then " ) +
+                            CVops::transform_class_name( kind );
+          if( !CVops::place_exactly( translatedMovingImg, kind, rotateCode,
+                                     offset, translatedMovingImg.size(),
+                                     cv::Scalar(255,255,255),
+                                     paddedRegisteredMovingImg ) )
+          {
+            cv::warpAffine( translatedMovingImg, paddedRegisteredMovingImg,
+                            rotateMatrix, translatedMovingImg.size(),
+                            interpolation, cv::BORDER_CONSTANT,
+                            cv::Scalar(255,255,255) );
+          }
+        }
+        catch( const cv::Exception& ex ) {
+          std::string err{"OpenCV cannot perform rotation: "};
+          err.append( ex.what() );
+          throw NFRL::Miscue( err );
+        }
+      }
+      imagery->paddedRegisteredMoving =
+        NFRL::VirtualPaddedImage( paddedRegisteredMovingImg, cv::Point( 0, 0 ),
+                                  canvasSize );
+    } );
+    warp.run( threads );
   }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot merge overlaid images: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
+  _metadata.push_back( "Transform class: " + transformClass );
+  if( paddedFixed.size() != canvasSize )
+  {
+    throw NFRL::Miscue( "Padded images not same size" );
   }
+  const NFRL::VirtualPaddedImage &paddedRegisteredMoving =
+    imagery->paddedRegisteredMoving;
+
+  // The padded images are white outside the registered footprint of the
+  // Moving image and outside the Fixed image, so the overlap search is
+  // bounded by the intersection of the two.  Virtually padded images store
+  // only those regions already.
+  const cv::Mat footprintTransform =
+    CVops::compose_affine_transforms( placedTranslateMatrix, rotateMatrix );
+  // Otsu thresholds of the padded canvases, from the source pixels only: the
+  // Moving histogram is read within its registered footprint, the Fixed
+  // histogram within the Fixed image, and the white padding is counted.
+  // Each image is one task.  The tiled engine has already overlapped the
+  // images.
+  NFRL::VirtualPaddedImage movingSearch = paddedRegisteredMoving;
+  NFRL::VirtualPaddedImage fixedSearch = paddedFixed;
+  int movingThresh{0}, fixedThresh{0};
+  const cv::Rect canvasRect( cv::Point( 0, 0 ), canvasSize );
+  NFRL::TaskGraph search;
+  search.add( [&]()
+  {
+    if( !virtualPadding )
+    {
+      cv::Rect footprint =
+        CVops::transformed_bounding_rect( img1.size(), footprintTransform,
+                                          WARP_SUPPORT_MARGIN ) & canvasRect;
+      movingSearch = NFRL::VirtualPaddedImage(
+                       paddedRegisteredMoving.materialize( footprint ),
+                       footprint.tl(), canvasSize );
+    }
+    if( !options.tiledEngine )
+    {
+      movingThresh = static_cast<int>( CVops::otsu_threshold(
+          CVops::footprint_histogram( movingSearch, footprintTransform,
+                                      img1.size(), WARP_SUPPORT_MARGIN ) ) );
+    }
+  } );
+  search.add( [&]()
+  {
+    if( !virtualPadding )
+    {
+      cv::Rect fixedRect( fixedOrigin, img2.size() );
+      fixedSearch = NFRL::VirtualPaddedImage( paddedFixed.materialize( fixedRect ),
+                                              fixedRect.tl(), canvasSize );
+    }
+    if( !options.tiledEngine && _preparedFixed )
+    {
+      // The stored pixels are the prepared (trimmed) Fixed image.
+      fixedThresh = static_cast<int>( CVops::otsu_threshold(
+          options.trimSourceMargins ? _preparedFixed->_foregroundHistogram
+                                    : _preparedFixed->_histogram,
+          fixedSearch.paddingCount(), fixedSearch.borderValue() ) );
+    }
+    else if( !options.tiledEngine )
+    {
+      fixedThresh = static_cast<int>( CVops::otsu_threshold( fixedSearch ) );
+    }
+  } );
+  search.run( threads );
 
   cv::Rect cropROI2;
   try {
-    NFRL::OverlapRegisteredImages ori( paddedRegisteredMovingImg,
-                                       paddedFixedImg );
-    _metadata.push_back( ori.to_s() );
-    cropROI2 = ori.getRegionOfInterest();
-    registrationMetadata.overlapROICorners = ori.getRegionOfInterestCorners();
-    // Retrieve the blob used to calculate ROI coordinates; this makes
-    // available the image to this library and (eventually) the user.
-    _vecPngBlob = ori.getPngBlob();
+    if( options.tiledEngine )
+    {
+      imagery->overlap.reset(
+        new NFRL::OverlapRegisteredImages( engine.overlap(),
+                                           engine.overlapRect(), canvasSize,
+                                           engine.overlapBox() ) );
+    }
+    else
+    {
+      imagery->overlap.reset(
+        new NFRL::OverlapRegisteredImages( movingSearch, fixedSearch,
+                                           movingThresh, fixedThresh,
+                                           options.roiCoarseFactor ) );
+    }
+    _metadata.push_back( imagery->overlap->to_s() );
+    cropROI2 = imagery->overlap->getRegionOfInterest();
+    registrationMetadata.overlapROICorners =
+      imagery->overlap->getRegionOfInterestCorners();
   }
   catch( NFRL::Miscue &e )
   {
@@ -938,30 +2286,28 @@ void Registrator::performRegistration()
   }
 
   // START FINAL output
-  try {
-    cv::Mat croppedMovingImg =
-            CVops::crop_image( paddedRegisteredMovingImg, cropROI2 );
-    cv::Mat croppedFixedImg = CVops::crop_image( paddedFixedImg, cropROI2 );
-    registrationMetadata.registeredImgSize.set( croppedFixedImg.cols,
-                                                croppedFixedImg.rows );
-
-    // Save to array just in case save to disk later.
-    std::vector<int> param(1);
-    param[0] = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
-    cv::imencode(".png", croppedMovingImg, _vecCroppedRegisteredImage, param);
-    cv::imencode(".png", croppedFixedImg, _vecCroppedFixedImage, param);
-    cv::imencode(".png", colorOverlaidRegisteredImages,
-                         _vecColorOverlaidRegisteredImages, param);
-    cv::imencode(".png", paddedFixedImg,
-                         _vecPaddedFixedImg, param);
-    cv::imencode(".png", paddedRegisteredMovingImg,
-                         _vecPaddedRegisteredMovingImg, param);
+  // Outputs are generated and encoded when first requested by the caller;
+  // only the state the selected outputs need is retained.
+  imagery->canvasSize = canvasSize;
+  imagery->cropRegion = cropROI2;
+  registrationMetadata.registeredImgSize.set( cropROI2.width,
+                                              cropROI2.height );
+  const unsigned int outputs = imagery->outputs;
+  if( !( outputs & ( croppedRegisteredImage | colorOverlaidImage |
+                     paddedRegisteredMovingImage ) ) )
+  {
+    imagery->paddedRegisteredMoving = NFRL::VirtualPaddedImage();
   }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OpenCV cannot crop or save final images: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
+  if( !( outputs & ( croppedFixedImage | colorOverlaidImage |
+                     paddedFixedImage ) ) )
+  {
+    imagery->paddedFixed = NFRL::VirtualPaddedImage();
+  }
+  if( !( outputs & overlapBlob ) )
+  {
+    imagery->overlap.reset();
   }
+  _imagery = std::move( imagery );
   // END FINAL output
 
   // Save the control points metadata. Three of the four points have been
@@ -1007,6 +2353,35 @@ void Registrator::performRegistration()
 
 // START Registrator struct definitions
 
+  /** @brief Format and, for PNG, the zlib level, strategy and filter.
+   *
+   * @return encoder settings in print format */
+  std::string Registrator::EncoderSettings::to_s() const
+  {
+    switch( format )
+    {
+      case pnmFormat : return "PGM/PPM";
+      case bmpFormat : return "BMP";
+      case pngFormat :
+      default        : break;
+    }
+    static const char* strategies[] = { "default", "filtered", "Huffman only",
+                                        "RLE", "fixed", "zlib default" };
+    static const char* filters[] = { "default", "none", "sub", "up", "average",
+                                     "Paeth", "all" };
+    std::string s{"PNG, level "};
+    s.append( pngLevel < 0 ? "default" : std::to_string( std::min( pngLevel, 9 ) ) );
+    s.append( ", strategy " );
+    s.append( strategies[ std::max( 0, std::min( pngStrategy - 1, 5 ) ) ] );
+    s.append( ", filter " );
+    s.append( filters[ std::max( 0, std::min( pngFilter - 1, 6 ) ) ] );
+    if( pngBilevel )
+      s.append( ", 1-bit blob" );
+    if( parallelPng )
+      s.append( ", NFRL strip encoder" );
+    return s;
+  }
+
   /** @brief `WxH`
    *
    * @return image dimensions as WxH */
@@ -26,9 +26,15 @@ of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #include "opencv_procs.h"
+#include "binary_image.h"
+#include "simd_kernels.h"
 
 #include <opencv2/opencv.hpp>
 
+#include <cfloat>
+#include <climits>
+#include <cstring>
+
 namespace CVops {
 
 /**
@@ -119,6 +125,240 @@ void binarize_image_via_threshold( const cv::Mat &imgIn, cv::Mat &imgBinary,
                  cv::THRESH_BINARY );
 }
 
+/**
+ * @brief Color overlay of the registered images, in a single pass.
+ *
+ * The Moving image is tinted green and the Fixed image magenta, and the two
+ * are blended with equal weight; the bytes are the same as cvtColor() to
+ * 3 channels, adding the tint scalars, and addWeighted( 0.5, 0.5 ).  Each
+ * canvas row is read once from each image and written once, and only the
+ * rows and columns of the stored pixels are computed.
+ *
+ * @param moving IN padded, registered Moving image
+ * @param fixed IN padded Fixed image, same canvas size
+ *
+ * @return 3-channel overlay canvas
+ */
+cv::Mat color_overlay( const NFRL::VirtualPaddedImage &moving,
+                       const NFRL::VirtualPaddedImage &fixed )
+{
+  uint8_t border[3];
+  const uint8_t bm = moving.borderValue(), bf = fixed.borderValue();
+  Kernels::overlay_tint( &bm, &bf, border, 1 );
+  cv::Mat overlay( moving.size(), CV_8UC3,
+                   cv::Scalar( border[0], border[1], border[2] ) );
+
+  const cv::Rect region = moving.sourceRect() | fixed.sourceRect();
+  if( region.empty() )
+    return overlay;
+  std::vector<uint8_t> scratchM( region.width ), scratchF( region.width );
+  for( int y=region.y; y<region.y + region.height; y++ )
+  {
+    Kernels::overlay_tint(
+      moving.rowSpan( y, region.x, region.width, scratchM.data() ),
+      fixed.rowSpan( y, region.x, region.width, scratchF.data() ),
+      overlay.ptr<uint8_t>(y) + 3 * region.x, region.width );
+  }
+  return overlay;
+}
+
+/**
+ * @brief Palette indices of the color overlay, see color_overlay_palette().
+ *
+ * @param moving IN padded, registered Moving image
+ * @param fixed IN padded Fixed image, same canvas size
+ *
+ * @return 1-channel canvas of palette indices
+ */
+cv::Mat color_overlay_indices( const NFRL::VirtualPaddedImage &moving,
+                               const NFRL::VirtualPaddedImage &fixed )
+{
+  uint8_t border;
+  const uint8_t bm = moving.borderValue(), bf = fixed.borderValue();
+  Kernels::overlay_palette_index( &bm, &bf, &border, 1 );
+  cv::Mat indices( moving.size(), CV_8UC1, cv::Scalar( border ) );
+
+  const cv::Rect region = moving.sourceRect() | fixed.sourceRect();
+  if( region.empty() )
+    return indices;
+  std::vector<uint8_t> scratchM( region.width ), scratchF( region.width );
+  for( int y=region.y; y<region.y + region.height; y++ )
+  {
+    Kernels::overlay_palette_index(
+      moving.rowSpan( y, region.x, region.width, scratchM.data() ),
+      fixed.rowSpan( y, region.x, region.width, scratchF.data() ),
+      indices.ptr<uint8_t>(y) + region.x, region.width );
+  }
+  return indices;
+}
+
+/**
+ * @brief Palette of the color overlay: 16 levels of each image.
+ *
+ * Index ( m << 4 ) | f is the overlay color of Moving gray m*17 and Fixed
+ * gray f*17, so level 15 is white and level 0 is black.
+ *
+ * @return 256 RGB triplets
+ */
+std::vector<uint8_t> color_overlay_palette()
+{
+  std::vector<uint8_t> palette( 3 * 256 );
+  for( int i=0; i<256; i++ )
+  {
+    const uint8_t m = static_cast<uint8_t>( ( i >> 4 ) * 17 );
+    const uint8_t f = static_cast<uint8_t>( ( i & 0x0F ) * 17 );
+    Kernels::overlay_tint( &m, &f, &palette[3*i], 1 );
+  }
+  return palette;
+}
+
+/** @brief CRC-32 of PNG chunks (ISO 3309), over type and data. */
+static uint32_t png_crc( const uint8_t *bytes, const size_t n,
+                         uint32_t crc = 0xFFFFFFFFu )
+{
+  static const std::array<uint32_t, 256> table = []()
+  {
+    std::array<uint32_t, 256> t;
+    for( uint32_t i=0; i<256; i++ )
+    {
+      uint32_t c = i;
+      for( int k=0; k<8; k++ )
+        c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  for( size_t i=0; i<n; i++ )
+    crc = table[( crc ^ bytes[i] ) & 0xFF] ^ ( crc >> 8 );
+  return crc;
+}
+
+/** @brief Append a PNG chunk: length, type, data and CRC. */
+static void append_png_chunk( std::vector<uint8_t> &png, const char *type,
+                              const uint8_t *data, const size_t n )
+{
+  const uint32_t len = static_cast<uint32_t>( n );
+  const uint8_t lenBytes[4] = { static_cast<uint8_t>( len >> 24 ),
+                                static_cast<uint8_t>( len >> 16 ),
+                                static_cast<uint8_t>( len >> 8 ),
+                                static_cast<uint8_t>( len ) };
+  png.insert( png.end(), lenBytes, lenBytes + 4 );
+  const size_t typeAt = png.size();
+  png.insert( png.end(), type, type + 4 );
+  png.insert( png.end(), data, data + n );
+  const uint32_t crc = png_crc( &png[typeAt], 4 + n ) ^ 0xFFFFFFFFu;
+  const uint8_t crcBytes[4] = { static_cast<uint8_t>( crc >> 24 ),
+                                static_cast<uint8_t>( crc >> 16 ),
+                                static_cast<uint8_t>( crc >> 8 ),
+                                static_cast<uint8_t>( crc ) };
+  png.insert( png.end(), crcBytes, crcBytes + 4 );
+}
+
+/**
+ * @brief Encode an 8-bit index image and its palette as a palette PNG.
+ *
+ * The indices are encoded by OpenCV as an 8-bit grayscale PNG; the filtered,
+ * compressed scanlines of a grayscale and a palette PNG of the same bytes are
+ * identical, so only the header color type is changed and the PLTE chunk is
+ * inserted.
+ *
+ * @param indices IN 8-bit, single-channel palette indices
+ * @param palette IN RGB triplets, at most 256
+ * @param png OUT byte-stream
+ * @param params IN OpenCV PNG encoder parameters, e.g., compression level;
+ *               none for OpenCV's defaults
+ *
+ * @throw NFRL::Miscue OpenCV did not write an 8-bit grayscale PNG
+ */
+void encode_png_palette( const cv::Mat &indices,
+                         const std::vector<uint8_t> &palette,
+                         std::vector<uint8_t> &png,
+                         const std::vector<int> &params )
+{
+  std::vector<uint8_t> gray;
+  cv::imencode( ".png", indices, gray, params );
+
+  const size_t sigSize = 8;
+  png.clear();
+  png.reserve( gray.size() + palette.size() + 12 );
+  png.insert( png.end(), gray.begin(), gray.begin() + sigSize );
+  size_t pos = sigSize;
+  bool headerFound = false;
+  while( pos + 12 <= gray.size() )
+  {
+    const size_t len = ( static_cast<size_t>( gray[pos] ) << 24 ) |
+                       ( static_cast<size_t>( gray[pos+1] ) << 16 ) |
+                       ( static_cast<size_t>( gray[pos+2] ) << 8 ) |
+                       static_cast<size_t>( gray[pos+3] );
+    const uint8_t *type = &gray[pos + 4];
+    if( pos + 12 + len > gray.size() )
+      break;
+    if( std::memcmp( type, "IHDR", 4 ) == 0 )
+    {
+      // bit depth at byte 8, color type at byte 9 of the header data
+      std::vector<uint8_t> header( type + 4, type + 4 + len );
+      if( len < 13 || header[8] != 8 || header[9] != 0 )
+        break;
+      header[9] = 3;   // palette
+      append_png_chunk( png, "IHDR", header.data(), header.size() );
+      append_png_chunk( png, "PLTE", palette.data(), palette.size() );
+      headerFound = true;
+    }
+    else
+    {
+      png.insert( png.end(), gray.begin() + pos, gray.begin() + pos + 12 + len );
+    }
+    pos += 12 + len;
+  }
+  if( !headerFound )
+  {
+    png.clear();
+    throw NFRL::Miscue( "cannot encode palette PNG, unexpected PNG header" );
+  }
+}
+
+
+/**
+ * @brief Encode an 8-bit image as a binary PGM (grayscale) or PPM (BGR).
+ *
+ * The header is text; the rows follow packed and uncompressed, so the
+ * encoding is a copy of the rows (PPM is RGB, so its pixels are reordered).
+ *
+ * @param img IN 8-bit, 1- or 3-channel image
+ * @param pnm OUT byte-stream
+ *
+ * @throw NFRL::Miscue not a 1- or 3-channel, 8-bit image
+ */
+void encode_pnm( const cv::Mat &img, std::vector<uint8_t> &pnm )
+{
+  const int channels = img.channels();
+  if( img.depth() != CV_8U || ( channels != 1 && channels != 3 ) )
+    throw NFRL::Miscue( "cannot encode PNM, not a 1- or 3-channel, 8-bit image" );
+
+  const std::string header = std::string( channels == 1 ? "P5\n" : "P6\n" ) +
+                             std::to_string( img.cols ) + " " +
+                             std::to_string( img.rows ) + "\n255\n";
+  const size_t rowBytes = static_cast<size_t>( img.cols ) * channels;
+  pnm.resize( header.size() + rowBytes * img.rows );
+  std::memcpy( pnm.data(), header.data(), header.size() );
+  uint8_t *dst = pnm.data() + header.size();
+  for( int y=0; y<img.rows; y++, dst += rowBytes )
+  {
+    const uint8_t *src = img.ptr<uint8_t>(y);
+    if( channels == 1 )
+    {
+      std::memcpy( dst, src, rowBytes );
+      continue;
+    }
+    for( int x=0; x<img.cols; x++ )
+    {
+      dst[3*x]     = src[3*x + 2];
+      dst[3*x + 1] = src[3*x + 1];
+      dst[3*x + 2] = src[3*x];
+    }
+  }
+}
+
 
 /**
  * @brief Convert cv::Mat type to 2D array of vectors.
@@ -168,6 +408,181 @@ Translate2D cast_translation_matrix( const cv::Mat &matrix )
 }
 
 
+/**
+ * @brief Combine two 2x3 affine transforms into one so that a single resample
+ *  applies both.
+ *
+ * Each transform maps a source pixel location to a destination location,
+ * as required by cv::warpAffine().  The result applies the first transform
+ * and then the second:
+ * ```
+ * | composed |   | second |   | first |
+ * |  0 0 1   | = | 0 0 1  | x | 0 0 1 |
+ * ```
+ *
+ * @param first IN transform applied first, CV_32F or CV_64F
+ * @param second IN transform applied second, CV_32F or CV_64F
+ *
+ * @return 2x3 matrix of type CV_64F
+ */
+cv::Mat compose_affine_transforms( const cv::Mat &first, const cv::Mat &second )
+{
+  double f[2][3], s[2][3];
+  for( int i=0; i<2; i++ )
+  {
+    for( int j=0; j<3; j++ )
+    {
+      f[i][j] = ( first.depth() == CV_32F ) ?
+                static_cast<double>( first.at<float>(i,j) ) :
+                first.at<double>(i,j);
+      s[i][j] = ( second.depth() == CV_32F ) ?
+                static_cast<double>( second.at<float>(i,j) ) :
+                second.at<double>(i,j);
+    }
+  }
+
+  cv::Mat composed( 2, 3, CV_64F );
+  for( int i=0; i<2; i++ )
+  {
+    for( int j=0; j<3; j++ )
+    {
+      double val = s[i][0] * f[0][j] + s[i][1] * f[1][j];
+      if( j == 2 )
+        val += s[i][2];
+      composed.at<double>(i,j) = val;
+    }
+  }
+  return composed;
+}
+
+
+/**
+ * @brief Classify a transform by the cheapest exact way to apply it.
+ *
+ * Identity, whole-pixel translations and rotations by multiples of 90
+ * degrees map every destination pixel onto a source pixel, so every OpenCV
+ * interpolation reproduces the source pixels exactly: no resample is
+ * needed.  Entries within 1e-9 of an integer are taken as that integer
+ * (cv::getRotationMatrix2D() of 90 degrees gives cosines of about 1e-17).
+ * For images up to 100,000 pixels per side, such entries move a mapped
+ * coordinate by at most 2e-4 pixel.  warpAffine() rounds the mapped
+ * coordinates to 10 fractional bits (its internal AB tables) before it
+ * interpolates at 1/32 pixel (cv::INTER_BITS), so that is less than half of
+ * its rounding step, and it would sample the same source pixels.
+ *
+ * @param transform IN 2x3 source-to-destination transform, CV_32F or CV_64F
+ * @param srcSize IN width and height of the source image
+ * @param rotateCode OUT cv::RotateFlags for rightAngleRotation, else -1
+ * @param offset OUT destination location of the top-left pixel of the
+ *               (rotated) source, unless generalTransform
+ *
+ * @return class of the transform
+ */
+TransformClass classify_transform( const cv::Mat &transform,
+                                   const cv::Size &srcSize, int &rotateCode,
+                                   cv::Point &offset )
+{
+  cv::Mat m;
+  transform.convertTo( m, CV_64F );
+  int e[6];
+  for( int i=0; i<6; i++ )
+  {
+    const double v = m.at<double>( i / 3, i % 3 );
+    const double r = std::round( v );
+    if( std::fabs( v - r ) > 1e-9 || std::fabs( r ) > INT_MAX / 2 )
+      return generalTransform;
+    e[i] = static_cast<int>( r );
+  }
+
+  const int a = e[0], b = e[1], c = e[3], d = e[4];
+  if( a == 1 && b == 0 && c == 0 && d == 1 )
+    rotateCode = -1;
+  else if( a == -1 && b == 0 && c == 0 && d == -1 )
+    rotateCode = cv::ROTATE_180;
+  else if( a == 0 && b == 1 && c == -1 && d == 0 )
+    rotateCode = cv::ROTATE_90_COUNTERCLOCKWISE;
+  else if( a == 0 && b == -1 && c == 1 && d == 0 )
+    rotateCode = cv::ROTATE_90_CLOCKWISE;
+  else
+    return generalTransform;
+
+  // Minimum of the mapped corners.
+  const int x1 = srcSize.width - 1, y1 = srcSize.height - 1;
+  offset.x = e[2] + std::min( 0, a * x1 ) + std::min( 0, b * y1 );
+  offset.y = e[5] + std::min( 0, c * x1 ) + std::min( 0, d * y1 );
+  if( rotateCode >= 0 )
+    return rightAngleRotation;
+  return ( e[2] == 0 && e[5] == 0 ) ? identityTransform : integerTranslation;
+}
+
+/**
+ * @brief Apply a transform that needs no resample, as OpenCV warpAffine()
+ *  with a constant border would.
+ *
+ * The source is rotated with transpose and flip if needed and copied row by
+ * row into the destination at its offset; the rest is the border value.
+ *
+ * @param src IN image to transform
+ * @param kind IN class of the transform, see classify_transform()
+ * @param rotateCode IN cv::RotateFlags of a rightAngleRotation, else -1
+ * @param offset IN destination location of the top-left pixel of the
+ *               (rotated) source
+ * @param dsize IN width and height of the destination
+ * @param borderValue IN value outside the source
+ * @param dst OUT transformed image, the type of src; not set if false is
+ *            returned
+ *
+ * @return false if the transform needs a resample (generalTransform)
+ */
+bool place_exactly( const cv::Mat &src, const TransformClass &kind,
+                    const int &rotateCode, const cv::Point &offset,
+                    const cv::Size &dsize, const cv::Scalar &borderValue,
+                    cv::Mat &dst )
+{
+  if( kind == generalTransform )
+    return false;
+
+  cv::Mat placed = src;
+  if( rotateCode >= 0 )
+    cv::rotate( src, placed, rotateCode );
+  cv::Mat out( dsize, src.type(), borderValue );
+  const cv::Rect target = cv::Rect( offset, placed.size() ) &
+                          cv::Rect( cv::Point( 0, 0 ), dsize );
+  if( !target.empty() )
+  {
+    cv::Mat region = out( target );
+    placed( target - offset ).copyTo( region );
+  }
+  dst = out;
+  return true;
+}
+
+/**
+ * @brief Store a source that needs no resample over its footprint, as is or
+ *  transposed/flipped.
+ *
+ * @param src IN image to place
+ * @param footprint IN canvas region of the warped source, see
+ *                  footprint_warp_matrix()
+ * @param rotateCode IN cv::RotateFlags of a rightAngleRotation, else -1
+ * @param offset IN location of the (rotated) source in the footprint, see
+ *               classify_transform()
+ *
+ * @return placed image on the same canvas
+ */
+NFRL::VirtualPaddedImage place_footprint( const NFRL::VirtualPaddedImage &src,
+                                          const cv::Rect &footprint,
+                                          const int &rotateCode,
+                                          const cv::Point &offset )
+{
+  cv::Mat placed = src.source();
+  if( rotateCode >= 0 )
+    cv::rotate( src.source(), placed, rotateCode );
+  return NFRL::VirtualPaddedImage( placed, footprint.tl() + offset,
+                                   src.size(), src.borderValue() );
+}
+
+
 /**
  * @brief Uses OpenCV crop_image() to crop an image given a cv::Rect object
  *  that represents the rectangular region to crop.
@@ -184,6 +599,81 @@ cv::Mat crop_image( const cv::Mat &img, const cv::Rect &roi)
 }
 
 
+/**
+ * @brief Bounding rectangle of the foreground (ridge area) of an image on a
+ *  light background, grown by a margin.
+ *
+ * The foreground is every pixel at most the Otsu threshold of the image.
+ * Rows are binarized straight to bits and ORed together, so the image is
+ * read once for the histogram and once for the bits.
+ *
+ * @param img IN 8-bit, single-channel image
+ * @param margin IN pixels added to each side, clipped to the image
+ *
+ * @return foreground rectangle; the whole image if there is no foreground
+ */
+cv::Rect foreground_rect( const cv::Mat &img, const int &margin )
+{
+  const cv::Rect whole( 0, 0, img.cols, img.rows );
+  if( whole.empty() )
+    return whole;
+  const int thresh = static_cast<int>( otsu_threshold( image_histogram( img ) ) );
+
+  NFRL::BinaryImage cols( cv::Size( img.cols, 1 ) );
+  std::vector<uint64_t> bits( cols.wordsPerRow() );
+  int top{-1}, bottom{-1};
+  for( int y=0; y<img.rows; y++ )
+  {
+    Kernels::pack_at_most( img.ptr<uint8_t>(y), bits.data(), img.cols, thresh );
+    uint64_t any{0};
+    for( const uint64_t word : bits )
+      any |= word;
+    if( any == 0 )
+      continue;
+    cols.orRow( 0, 0, bits.data(), img.cols );
+    if( top < 0 )
+      top = y;
+    bottom = y;
+  }
+  int left, right;
+  if( top < 0 || !cols.rowExtent( 0, left, right ) )
+    return whole;
+  return cv::Rect( left - margin, top - margin,
+                   right - left + 1 + 2*margin,
+                   bottom - top + 1 + 2*margin ) & whole;
+}
+
+
+/**
+ * @brief 8-bit grayscale image of caller-owned pixels.
+ *
+ * Grayscale pixels are shared, not copied; color pixels (BGR or BGRA) are
+ * converted by cvtColor() into a new image.
+ *
+ * @param data IN first pixel of the first row
+ * @param width IN pixels per row
+ * @param height IN rows
+ * @param stride IN bytes between rows
+ * @param channels IN 1, 3 (BGR), or 4 (BGRA)
+ *
+ * @return single-channel image
+ */
+cv::Mat grayscale_image( const uint8_t *data, const int &width,
+                         const int &height, const size_t &stride,
+                         const int &channels )
+{
+  cv::Mat img( height, width, CV_8UC(channels),
+               const_cast<uint8_t*>( data ), stride );
+  if( channels == 1 )
+    return img;
+
+  cv::Mat gray;
+  cv::cvtColor( img, gray,
+                channels == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY );
+  return gray;
+}
+
+
 /**
  * @brief Uses OpenCV dilate() to dilate/thicken the image.
  *
@@ -222,31 +712,259 @@ void image_dilate( const cv::Mat &img, cv::Mat &imgDilate,
   cv::dilate( img, imgDilate, element );
 }
 
+/**
+ * @brief Bounding rectangle of an image after it is warped by an affine
+ *  transform.
+ *
+ * The four corners of the source image, extended by the margin on all sides,
+ * are mapped through the transform.  The margin accounts for destination
+ * pixels that are blended with source pixels by the interpolation.  Every
+ * destination pixel outside the returned rectangle is border-only.
+ *
+ * @param srcSize IN width and height of the source image
+ * @param transform IN 2x3 source-to-destination transform, CV_32F or CV_64F
+ * @param margin IN pixels past the source edges to include
+ *
+ * @return smallest integer rectangle that contains the mapped corners
+ */
+cv::Rect transformed_bounding_rect( const cv::Size &srcSize,
+                                    const cv::Mat &transform,
+                                    const int &margin )
+{
+  cv::Mat m;
+  transform.convertTo( m, CV_64F );
+
+  const double xs[2] = { static_cast<double>( -margin ),
+                         static_cast<double>( srcSize.width - 1 + margin ) };
+  const double ys[2] = { static_cast<double>( -margin ),
+                         static_cast<double>( srcSize.height - 1 + margin ) };
+  double minX{0.0}, maxX{0.0}, minY{0.0}, maxY{0.0};
+  for( int i=0; i<4; i++ )
+  {
+    double x = xs[i & 1];
+    double y = ys[i >> 1];
+    double u = m.at<double>(0,0) * x + m.at<double>(0,1) * y + m.at<double>(0,2);
+    double v = m.at<double>(1,0) * x + m.at<double>(1,1) * y + m.at<double>(1,2);
+    if( i == 0 || u < minX ) minX = u;
+    if( i == 0 || u > maxX ) maxX = u;
+    if( i == 0 || v < minY ) minY = v;
+    if( i == 0 || v > maxY ) maxY = v;
+  }
+
+  int x0 = static_cast<int>( std::floor( minX ) );
+  int y0 = static_cast<int>( std::floor( minY ) );
+  int x1 = static_cast<int>( std::ceil( maxX ) );
+  int y1 = static_cast<int>( std::ceil( maxY ) );
+  return cv::Rect( x0, y0, x1 - x0 + 1, y1 - y0 + 1 );
+}
+
 
 /**
- * @brief "Sum" the two image erosions to calculate the overlap.
+ * @brief Add a run of pixels to four interleaved sub-histograms.
  *
- * This is done pixel-by-pixel.  If both pixels are black (0), then set the
- * pixel at the coordinates to 0.  Otherwise set to white (255).
- * Obviously, both images must have the same width-by-height dimensions.
- * 
- * @param img1 IN addend
- * @param img2 IN addend
- * @param imgSum OUT the sum of the two binary images
+ * Consecutive equal pixels (runs of white) go to different sub-histograms,
+ * so each increment does not wait on the previous one.
  */
-void sum_two_binary_images( const cv::Mat &img1, const cv::Mat &img2,
-                            cv::Mat &imgSum )
+static void accumulate_histogram( const uint8_t *pixels, const int n,
+                                  uint64_t (*sub)[256] )
 {
-  for(int i=0; i < img1.rows; i++) {
-    for(int j=0; j < img1.cols; j++) {
-      if( (img1.at<uint8_t>(i,j) == 0 ) && (img2.at<uint8_t>(i,j) == 0 ) ) {
-        imgSum.at<uint8_t>(i,j) = 0;
-      }
-      else {
-        imgSum.at<uint8_t>(i,j) = 255;
+  int j{0};
+  for( ; j + 4 <= n; j += 4 )
+  {
+    sub[0][pixels[j]]++;
+    sub[1][pixels[j+1]]++;
+    sub[2][pixels[j+2]]++;
+    sub[3][pixels[j+3]]++;
+  }
+  for( ; j < n; j++ )
+    sub[0][pixels[j]]++;
+}
+
+/** @brief Sum the sub-histograms into one. */
+static Histogram merge_histograms( const uint64_t (*sub)[256] )
+{
+  Histogram hist;
+  for( int i=0; i<256; i++ )
+    hist[i] = sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i];
+  return hist;
+}
+
+/**
+ * @brief Histogram of an 8-bit, single-channel image.
+ *
+ * @param img IN image
+ *
+ * @return count of pixels per value
+ */
+Histogram image_histogram( const cv::Mat &img )
+{
+  uint64_t sub[4][256] = {};
+  for( int i=0; i<img.rows; i++ )
+    accumulate_histogram( img.ptr<uint8_t>(i), img.cols, sub );
+  return merge_histograms( sub );
+}
+
+/**
+ * @brief Histogram of the canvas of a warped, virtually padded image, read
+ *  only within the warped footprint of the source image.
+ *
+ * The stored pixels of a warp are the bounding rectangle of the footprint,
+ * so the corners of a rotated footprint are border-only.  Each stored row is
+ * read only within its span of the footprint (the source extended by the
+ * margin, as for transformed_bounding_rect()); every other canvas pixel is
+ * counted in the border-value bin.  The histogram is the same as that of
+ * the materialized canvas.
+ *
+ * @param img IN warped image, 8-bit, single-channel
+ * @param transform IN 2x3 source-to-canvas transform of the warp
+ * @param srcSize IN width and height of the source image of the warp
+ * @param margin IN pixels past the source edges reached by the resample
+ *
+ * @return count of canvas pixels per value
+ */
+Histogram footprint_histogram( const NFRL::VirtualPaddedImage &img,
+                               const cv::Mat &transform,
+                               const cv::Size &srcSize, const int &margin )
+{
+  cv::Mat m;
+  transform.convertTo( m, CV_64F );
+  const double a = m.at<double>(0,0), b = m.at<double>(0,1);
+  const double c = m.at<double>(1,0), d = m.at<double>(1,1);
+  const double tx = m.at<double>(0,2), ty = m.at<double>(1,2);
+  const double det = a * d - b * c;
+
+  const cv::Mat &src = img.source();
+  const cv::Point offset = img.offset();
+  uint64_t sub[4][256] = {};
+  uint64_t counted{0};
+  if( std::fabs( det ) > DBL_EPSILON )
+  {
+    // Canvas pixel (x, y) maps back to source ( p0 + x*a0, p1 + x*a1 ).
+    const double a0 = d / det, a1 = -c / det;
+    const double loX = -margin, hiX = srcSize.width - 1 + margin;
+    const double loY = -margin, hiY = srcSize.height - 1 + margin;
+    for( int i=0; i<src.rows; i++ )
+    {
+      const double v = offset.y + i - ty;
+      const double p0 = ( -d * tx - b * v ) / det;
+      const double p1 = ( c * tx + a * v ) / det;
+
+      double xMin = offset.x, xMax = offset.x + src.cols - 1;
+      const double as[2] = { a0, a1 }, ps[2] = { p0, p1 };
+      const double los[2] = { loX, loY }, his[2] = { hiX, hiY };
+      for( int k=0; k<2 && xMin <= xMax; k++ )
+      {
+        if( std::fabs( as[k] ) < DBL_EPSILON )
+        {
+          if( ps[k] < los[k] || ps[k] > his[k] )
+            xMin = xMax + 1;
+          continue;
+        }
+        double x0 = ( los[k] - ps[k] ) / as[k];
+        double x1 = ( his[k] - ps[k] ) / as[k];
+        if( x0 > x1 )
+          std::swap( x0, x1 );
+        // One pixel of slack either side, for the coordinate rounding.
+        xMin = std::max( xMin, std::floor( x0 ) - 1 );
+        xMax = std::min( xMax, std::ceil( x1 ) + 1 );
       }
+      if( xMin > xMax )
+        continue;
+
+      const int first = static_cast<int>( xMin ) - offset.x;
+      const int n = static_cast<int>( xMax ) - static_cast<int>( xMin ) + 1;
+      accumulate_histogram( src.ptr<uint8_t>(i) + first, n, sub );
+      counted += static_cast<uint64_t>( n );
     }
   }
+  else
+  {
+    // Degenerate transform; read all the stored pixels.
+    for( int i=0; i<src.rows; i++ )
+      accumulate_histogram( src.ptr<uint8_t>(i), src.cols, sub );
+    counted = src.total();
+  }
+
+  Histogram hist = merge_histograms( sub );
+  hist[img.borderValue()] +=
+    static_cast<uint64_t>( img.size().area() ) - counted;
+  return hist;
+}
+
+/**
+ * @brief Otsu threshold from a histogram plus a count of padding pixels.
+ *
+ * The padding pixels are added to the bin of their value, so the threshold
+ * is that of the padded image without reading the padding.  The threshold
+ * search is that of OpenCV threshold() with THRESH_OTSU.
+ *
+ * @param hist IN histogram of the stored (non-padding) pixels
+ * @param paddingCount IN number of padding pixels
+ * @param paddingValue IN value of every padding pixel
+ *
+ * @return threshold value, 0 if there are no pixels
+ */
+double otsu_threshold( const Histogram &hist, const size_t &paddingCount,
+                       const uint8_t &paddingValue )
+{
+  const int N = 256;
+  double h[N] = {0.0};
+  uint64_t total{0};
+  for( int i=0; i<N; i++ )
+  {
+    h[i] = static_cast<double>( hist[i] );
+    total += hist[i];
+  }
+  h[paddingValue] += static_cast<double>( paddingCount );
+  total += paddingCount;
+  if( total == 0 )
+    return 0.0;
+
+  double scale = 1.0 / static_cast<double>( total );
+  double mu{0.0};
+  for( int i=0; i<N; i++ )
+    mu += i * h[i];
+  mu *= scale;
+
+  double mu1{0.0}, q1{0.0};
+  double maxSigma{0.0}, maxVal{0.0};
+  for( int i=0; i<N; i++ )
+  {
+    double p_i = h[i] * scale;
+    mu1 *= q1;
+    q1 += p_i;
+    double q2 = 1.0 - q1;
+
+    if( std::min( q1, q2 ) < FLT_EPSILON || std::max( q1, q2 ) > 1.0 - FLT_EPSILON )
+      continue;
+
+    mu1 = ( mu1 + i * p_i ) / q1;
+    double mu2 = ( mu - q1 * mu1 ) / q2;
+    double sigma = q1 * q2 * ( mu1 - mu2 ) * ( mu1 - mu2 );
+    if( sigma > maxSigma )
+    {
+      maxSigma = sigma;
+      maxVal = i;
+    }
+  }
+  return maxVal;
+}
+
+/**
+ * @brief Otsu threshold of a virtually padded image without materializing it.
+ *
+ * The histogram of the stored pixels is completed by adding the padding
+ * pixels to the border-value bin, so the value is the same as for the full,
+ * padded canvas.
+ *
+ * @param img IN 8-bit, single-channel image
+ *
+ * @return threshold value
+ */
+double otsu_threshold( const NFRL::VirtualPaddedImage &img )
+{
+  return otsu_threshold( image_histogram( img.source() ), img.paddingCount(),
+                         img.borderValue() );
 }
 
 
@@ -280,6 +998,320 @@ std::string rotation_matrix_to_s( const cv::Mat &matrix )
 }
 
 
+/**
+ * @brief Support for logging.
+ *
+ * @param kind IN class of a transform
+ *
+ * @return name of the class
+ */
+const char* transform_class_name( const TransformClass kind )
+{
+  switch( kind )
+  {
+    case identityTransform  : return "identity";
+    case integerTranslation : return "integer translation";
+    case rightAngleRotation : return "right-angle rotation";
+    case generalTransform   :
+    default                 : return "general";
+  }
+}
+
+
+/**
+ * @brief Transform and footprint of a warp that stores only the footprint.
+ *
+ * @param src IN image to warp
+ * @param transform IN 2x3 canvas-to-canvas transform, CV_32F or CV_64F
+ * @param supportMargin IN pixels past the source edges that interpolation
+ *                      can reach
+ * @param footprint OUT canvas region of the warped source, may be empty
+ *
+ * @return 2x3, CV_64F transform from the stored source pixels to the
+ *         footprint
+ */
+cv::Mat footprint_warp_matrix( const NFRL::VirtualPaddedImage &src,
+                               const cv::Mat &transform,
+                               const int &supportMargin,
+                               cv::Rect &footprint )
+{
+  float placementData[6] = {
+    1, 0, static_cast<float>( src.offset().x ),
+    0, 1, static_cast<float>( src.offset().y ) };
+  cv::Mat m = compose_affine_transforms(
+                cv::Mat( 2, 3, CV_32F, placementData ), transform );
+
+  footprint =
+    transformed_bounding_rect( src.source().size(), m, supportMargin ) &
+    cv::Rect( cv::Point( 0, 0 ), src.size() );
+  if( src.source().empty() || footprint.empty() )
+  {
+    footprint = cv::Rect();
+    return m;
+  }
+  m.at<double>(0,2) -= footprint.x;
+  m.at<double>(1,2) -= footprint.y;
+  return m;
+}
+
+/**
+ * @brief Uses OpenCV warpAffine() to resample only the footprint of the
+ *  warped image on its canvas.
+ *
+ * The canvas outside the source is the border value, the same constant
+ * warpAffine() uses outside its input, so the result equals warping the
+ * materialized canvas, up to OpenCV's fixed-point rounding of the mapped
+ * coordinates (10 fractional bits in its AB tables), which depends on the
+ * footprint origin.  Transforms
+ * that need no resample (see classify_transform()) only place the source on
+ * the canvas; it is copied only if it is rotated.
+ *
+ * @param src IN image to warp
+ * @param transform IN 2x3 canvas-to-canvas transform, CV_32F or CV_64F
+ * @param interpolation IN cv::InterpolationFlags
+ * @param supportMargin IN pixels past the source edges that interpolation
+ *                      can reach
+ * @param kind OUT class of the transform from the stored source pixels,
+ *             which chose between placement and resample
+ * @param fixedPoint IN resample with warp_rigid_region() instead of
+ *                   warpAffine()
+ *
+ * @return warped image on the same canvas, stored over its footprint only
+ */
+NFRL::VirtualPaddedImage warp_affine( const NFRL::VirtualPaddedImage &src,
+                                      const cv::Mat &transform,
+                                      const int &interpolation,
+                                      const int &supportMargin,
+                                      TransformClass &kind,
+                                      const bool &fixedPoint )
+{
+  cv::Rect footprint;
+  cv::Mat m = footprint_warp_matrix( src, transform, supportMargin, footprint );
+  int rotateCode;
+  cv::Point offset;
+  kind = classify_transform( m, src.source().size(), rotateCode, offset );
+  if( footprint.empty() )
+  {
+    return NFRL::VirtualPaddedImage( cv::Mat(), cv::Point( 0, 0 ), src.size(),
+                                     src.borderValue() );
+  }
+
+  // No resample if every pixel maps onto a source pixel; the source is
+  // stored as is (or transposed/flipped) at its offset.
+  if( kind != generalTransform )
+    return place_footprint( src, footprint, rotateCode, offset );
+
+  cv::Mat warped;
+  if( fixedPoint )
+  {
+    // Bands of rows in parallel; the pixels do not depend on the split.
+    const int bandRows = 64;
+    warped.create( footprint.size(), CV_8UC1 );
+    const int nBands = ( footprint.height + bandRows - 1 ) / bandRows;
+    cv::parallel_for_( cv::Range( 0, nBands ), [&]( const cv::Range &range )
+    {
+      for( int b=range.start; b<range.end; b++ )
+      {
+        const cv::Rect band = cv::Rect( 0, b * bandRows, footprint.width,
+                                        bandRows ) &
+                              cv::Rect( cv::Point( 0, 0 ), footprint.size() );
+        cv::Mat dst = warped( band );
+        warp_rigid_region( src.source(), m, band, interpolation,
+                           src.borderValue(), dst );
+      }
+    } );
+  }
+  else
+  {
+    cv::warpAffine( src.source(), warped, m, footprint.size(),
+                    interpolation, cv::BORDER_CONSTANT,
+                    cv::Scalar::all( src.borderValue() ) );
+  }
+  return NFRL::VirtualPaddedImage( warped, footprint.tl(), src.size(),
+                                   src.borderValue() );
+}
+
+/** @brief Fixed-point scale of the warp coordinates, as warpAffine(). */
+static const int WARP_COORD_SCALE = 1 << Kernels::WARP_COORD_BITS;
+
+/**
+ * @brief Inverse transform and per-column coordinate steps of a warp, as
+ *  warpAffine() calculates them.
+ *
+ * Destination pixel ( x, y ) maps to the source coordinates
+ * ( X0(y) + adelta[x], Y0(y) + bdelta[x] ), WARP_COORD_BITS fractional bits,
+ * where X0(y) = ( M[1]*y + M[2] ) * scale and Y0(y) = ( M[4]*y + M[5] ) * scale.
+ * The steps are calculated from the pixel's column in the whole destination,
+ * so they do not depend on the region.
+ *
+ * @param transform IN 2x3 source-to-destination transform, CV_64F
+ * @param region IN region of the destination
+ * @param M OUT inverse transform, row-major
+ * @param adelta OUT x-coordinate step of each column of the region
+ * @param bdelta OUT y-coordinate step of each column of the region
+ */
+static void warp_coordinates( const cv::Mat &transform, const cv::Rect &region,
+                              double M[6], std::vector<int> &adelta,
+                              std::vector<int> &bdelta )
+{
+  // Invert the transform exactly as warpAffine() does.
+  for( int i=0; i<6; i++ )
+    M[i] = transform.at<double>( i / 3, i % 3 );
+  double D = M[0]*M[4] - M[1]*M[3];
+  D = D != 0 ? 1./D : 0;
+  double A11 = M[4]*D, A22 = M[0]*D;
+  M[0] = A11; M[1] *= -D;
+  M[3] *= -D; M[4] = A22;
+  double b1 = -M[0]*M[2] - M[1]*M[5];
+  double b2 = -M[3]*M[2] - M[4]*M[5];
+  M[2] = b1; M[5] = b2;
+
+  adelta.resize( region.width );
+  bdelta.resize( region.width );
+  for( int x=0; x<region.width; x++ )
+  {
+    adelta[x] = cv::saturate_cast<int>( M[0]*( region.x + x )*WARP_COORD_SCALE );
+    bdelta[x] = cv::saturate_cast<int>( M[3]*( region.x + x )*WARP_COORD_SCALE );
+  }
+}
+
+/**
+ * @brief Warp one region of the destination, independently of the rest.
+ *
+ * The fixed-point source coordinates of every destination pixel are
+ * calculated as OpenCV warpAffine() calculates them (inverse transform,
+ * 1/1024-pixel rows and column steps, 1/32-pixel interpolation table) from
+ * the pixel's position in the whole destination, and the region is resampled
+ * by remap() with those maps.  So any partition of the destination into
+ * regions, in any order or on any thread, gives the same pixels as one
+ * warpAffine() of the whole destination (the generic, table-driven
+ * implementation).
+ *
+ * @param src IN 8-bit, single-channel image to warp
+ * @param transform IN 2x3 source-to-destination transform, CV_64F
+ * @param region IN region of the destination to warp
+ * @param interpolation IN INTER_NEAREST, INTER_LINEAR or INTER_CUBIC
+ * @param borderValue IN value outside the source
+ * @param dst OUT warped region, allocated if not region-sized 8-bit
+ */
+void warp_affine_region( const cv::Mat &src, const cv::Mat &transform,
+                         const cv::Rect &region, const int &interpolation,
+                         const uint8_t &borderValue, cv::Mat &dst )
+{
+  const int AB_BITS = Kernels::WARP_COORD_BITS;
+  double M[6];
+  std::vector<int> adelta, bdelta;
+  warp_coordinates( transform, region, M, adelta, bdelta );
+  const bool nearest = ( interpolation == cv::INTER_NEAREST );
+  const int roundDelta = nearest ? WARP_COORD_SCALE/2
+                                 : WARP_COORD_SCALE/cv::INTER_TAB_SIZE/2;
+
+  dst.create( region.size(), CV_8UC1 );
+  // Maps for a band of rows at a time, small enough to stay in cache.
+  const int bandRows = 16;
+  cv::Mat xy( std::min( bandRows, region.height ), region.width, CV_16SC2 );
+  cv::Mat alpha( xy.rows, region.width, CV_16UC1 );
+  for( int y0=0; y0<region.height; y0+=bandRows )
+  {
+    const int rows = std::min( bandRows, region.height - y0 );
+    for( int r=0; r<rows; r++ )
+    {
+      const int y = region.y + y0 + r;
+      const int X0 = cv::saturate_cast<int>( ( M[1]*y + M[2] )*WARP_COORD_SCALE ) + roundDelta;
+      const int Y0 = cv::saturate_cast<int>( ( M[4]*y + M[5] )*WARP_COORD_SCALE ) + roundDelta;
+      short *xyRow = xy.ptr<short>( r );
+      ushort *aRow = alpha.ptr<ushort>( r );
+      for( int x=0; x<region.width; x++ )
+      {
+        if( nearest )
+        {
+          xyRow[2*x] = cv::saturate_cast<short>( ( X0 + adelta[x] ) >> AB_BITS );
+          xyRow[2*x+1] = cv::saturate_cast<short>( ( Y0 + bdelta[x] ) >> AB_BITS );
+        }
+        else
+        {
+          const int X = ( X0 + adelta[x] ) >> ( AB_BITS - cv::INTER_BITS );
+          const int Y = ( Y0 + bdelta[x] ) >> ( AB_BITS - cv::INTER_BITS );
+          xyRow[2*x] = cv::saturate_cast<short>( X >> cv::INTER_BITS );
+          xyRow[2*x+1] = cv::saturate_cast<short>( Y >> cv::INTER_BITS );
+          aRow[x] = static_cast<ushort>(
+                      ( Y & ( cv::INTER_TAB_SIZE - 1 ) ) * cv::INTER_TAB_SIZE +
+                      ( X & ( cv::INTER_TAB_SIZE - 1 ) ) );
+        }
+      }
+    }
+    cv::Mat band = dst( cv::Rect( 0, y0, region.width, rows ) );
+    cv::Mat xyBand = xy( cv::Rect( 0, 0, region.width, rows ) );
+    cv::remap( src, band, xyBand,
+               nearest ? cv::Mat() : alpha( cv::Rect( 0, 0, region.width, rows ) ),
+               interpolation, cv::BORDER_CONSTANT, cv::Scalar::all( borderValue ) );
+  }
+}
+
+
+/**
+ * @brief NFRL's own resample of one region of the destination, for 8-bit
+ *  images and rigid (rotation and translation) transforms.
+ *
+ * The coordinates are those of warp_affine_region(), so any partition of
+ * the destination gives the same pixels.  The interpolation is NFRL's (see
+ * Kernels::warp_bilinear_row()): integer arithmetic only, so the pixels are
+ * identical on every CPU, OpenCV version and thread count.  Bilinear pixels
+ * may differ from warpAffine() by a gray level, since OpenCV quantizes the
+ * weights differently.  Interpolations other than nearest and bilinear are
+ * left to warp_affine_region().
+ *
+ * @param src IN 8-bit, single-channel image to warp
+ * @param transform IN 2x3 source-to-destination transform, CV_64F
+ * @param region IN region of the destination to warp
+ * @param interpolation IN INTER_NEAREST or INTER_LINEAR
+ * @param borderValue IN value outside the source
+ * @param dst OUT warped region, allocated if not region-sized 8-bit
+ */
+void warp_rigid_region( const cv::Mat &src, const cv::Mat &transform,
+                        const cv::Rect &region, const int &interpolation,
+                        const uint8_t &borderValue, cv::Mat &dst )
+{
+  if( interpolation != cv::INTER_NEAREST && interpolation != cv::INTER_LINEAR )
+  {
+    warp_affine_region( src, transform, region, interpolation, borderValue, dst );
+    return;
+  }
+  dst.create( region.size(), CV_8UC1 );
+  if( src.empty() )
+  {
+    dst = cv::Scalar::all( borderValue );
+    return;
+  }
+
+  double M[6];
+  std::vector<int> adelta, bdelta;
+  warp_coordinates( transform, region, M, adelta, bdelta );
+  const bool nearest = ( interpolation == cv::INTER_NEAREST );
+  const int roundDelta = nearest ? WARP_COORD_SCALE/2
+                                 : WARP_COORD_SCALE >> ( Kernels::WARP_WEIGHT_BITS + 1 );
+
+  Kernels::WarpSource source;
+  source.data = src.ptr<uint8_t>(0);
+  source.step = src.step;
+  source.width = src.cols;
+  source.height = src.rows;
+  source.border = borderValue;
+  for( int r=0; r<region.height; r++ )
+  {
+    const int y = region.y + r;
+    const int X0 = cv::saturate_cast<int>( ( M[1]*y + M[2] )*WARP_COORD_SCALE ) + roundDelta;
+    const int Y0 = cv::saturate_cast<int>( ( M[4]*y + M[5] )*WARP_COORD_SCALE ) + roundDelta;
+    if( nearest )
+      Kernels::warp_nearest_row( source, adelta.data(), bdelta.data(), X0, Y0,
+                                 dst.ptr<uint8_t>(r), region.width );
+    else
+      Kernels::warp_bilinear_row( source, adelta.data(), bdelta.data(), X0, Y0,
+                                  dst.ptr<uint8_t>(r), region.width );
+  }
+}
+
+
 /**
  * @brief Support for logging.
  *
@@ -27,12 +27,35 @@ identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #include "opencv_procs.h"
 #include "overlap_registered_images.h"
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <utility>
 
 
 namespace NFRL {
 
 #define ROI_THRESH 12   // minimum width and height thresholds
 
+namespace {
+
+/**
+ * @brief Bits set where both images are at most their thresholds, over a
+ *  region of the canvas.
+ */
+BinaryImage overlap_bits( const VirtualPaddedImage &img1,
+                          const VirtualPaddedImage &img2,
+                          const int thresh1, const int thresh2,
+                          const cv::Rect &region )
+{
+  BinaryImage bits = BinaryImage::fromAtMost( img1.materialize( region ),
+                                              thresh1 );
+  bits &= BinaryImage::fromAtMost( img2.materialize( region ), thresh2 );
+  return bits;
+}
+
+}   // END anonymous namespace
+
 /** Initialization function that resets all values. */
 void OverlapRegisteredImages::Init() {
   _dilationKernelParams.size = -1;
@@ -81,51 +104,341 @@ OverlapRegisteredImages::OverlapRegisteredImages( cv::Mat img1, cv::Mat img2 )
   _dilationKernelParams.type = cv::MORPH_RECT;
   _dilationKernelParams.size = 1;
 
+  VirtualPaddedImage padded1( img1, cv::Point( 0, 0 ), img1.size() );
+  VirtualPaddedImage padded2( img2, cv::Point( 0, 0 ), img2.size() );
+  calcOverlap( padded1, padded2,
+               static_cast<int>( CVops::otsu_threshold( padded1 ) ),
+               static_cast<int>( CVops::otsu_threshold( padded2 ) ) );
+  calcRegionOfInterest( _overlap.boundingRect() );
+}
+
+/**
+ * @brief Same as the cv::Mat constructor, for virtually padded images.
+ *
+ * Each image is white outside its stored pixels, so the binaries overlap
+ * only where the stored pixels of both images intersect; only that region
+ * is summed and searched.  The ROI is the same as for the materialized
+ * images.
+ *
+ * @param img1 - padded, same canvas size as img2
+ * @param img2 - padded, same canvas size as img1
+ */
+OverlapRegisteredImages::OverlapRegisteredImages( const VirtualPaddedImage &img1,
+                                                  const VirtualPaddedImage &img2 )
+{
+  // Opencv support,  MORPH_ELLIPSE  MORPH_CROSS  MORPH_RECT
+  _dilationKernelParams.type = cv::MORPH_RECT;
+  _dilationKernelParams.size = 1;
+
+  calcOverlap( img1, img2,
+               static_cast<int>( CVops::otsu_threshold( img1 ) ),
+               static_cast<int>( CVops::otsu_threshold( img2 ) ) );
+  calcRegionOfInterest( _overlap.boundingRect() );
+}
+
+/**
+ * @brief Same as the virtually padded constructor, with the Otsu threshold
+ *  of each image already calculated, e.g., from the footprint histogram of
+ *  a warped image (see CVops::footprint_histogram()).
+ *
+ * With a coarse factor of 4 or 8 the ROI is searched coarse-to-fine (see
+ * calcOverlapCoarseToFine()); the ROI is the same.
+ *
+ * @param img1 - padded, same canvas size as img2
+ * @param img2 - padded, same canvas size as img1
+ * @param thresh1 - Otsu threshold of the img1 canvas
+ * @param thresh2 - Otsu threshold of the img2 canvas
+ * @param coarseFactor - pixels per side of a coarse block, 0 (default) for
+ *                       the full-resolution search
+ */
+OverlapRegisteredImages::OverlapRegisteredImages( const VirtualPaddedImage &img1,
+                                                  const VirtualPaddedImage &img2,
+                                                  const int thresh1,
+                                                  const int thresh2,
+                                                  const int coarseFactor )
+{
+  // Opencv support,  MORPH_ELLIPSE  MORPH_CROSS  MORPH_RECT
+  _dilationKernelParams.type = cv::MORPH_RECT;
+  _dilationKernelParams.size = 1;
+
+  if( coarseFactor > 1 )
+  {
+    calcRegionOfInterest(
+      calcOverlapCoarseToFine( img1, img2, thresh1, thresh2, coarseFactor ) );
+    return;
+  }
+  calcOverlap( img1, img2, thresh1, thresh2 );
+  calcRegionOfInterest( _overlap.boundingRect() );
+}
+
+/**
+ * @brief The overlap bits and their bounding box are already calculated;
+ *  only the ROI is derived from them.
+ *
+ * @param overlap - AND of the "at most threshold" bits over overlapRect
+ * @param overlapRect - canvas region of the overlap bits
+ * @param canvasSize - width and height of the canvas
+ * @param box - bounding box of the set overlap bits, in their coordinates
+ */
+OverlapRegisteredImages::OverlapRegisteredImages( BinaryImage overlap,
+                                                  const cv::Rect &overlapRect,
+                                                  const cv::Size &canvasSize,
+                                                  const cv::Rect &box )
+  : _canvasSize(canvasSize), _overlapRect(overlapRect),
+    _overlap( std::move( overlap ) )
+{
+  // Opencv support,  MORPH_ELLIPSE  MORPH_CROSS  MORPH_RECT
+  _dilationKernelParams.type = cv::MORPH_RECT;
+  _dilationKernelParams.size = 1;
+
+  calcRegionOfInterest( box );
+}
+
+/**
+ * @brief Binarize and "sum" the images straight to bits.
+ *
+ * A binarized pixel is black where the pixel is at most its image's Otsu
+ * threshold, and the sum is black only where both binaries are black.  So
+ * the inverted sum is the AND of the two "at most threshold" bit images; no
+ * 8-bit binary, sum or inverted image is allocated.  Only the canvas region
+ * where both binaries may be black is computed: the intersection of the
+ * stored pixels, unless a (degenerate) border is itself black.
+ *
+ * @param img1 IN padded, same canvas size as img2
+ * @param img2 IN padded, same canvas size as img1
+ * @param thresh1 IN Otsu threshold of img1 (Otsu thresholds are integral)
+ * @param thresh2 IN Otsu threshold of img2
+ *
+ * @throw NFRL::Miscue cannot calc image-crop ROI
+ */
+void OverlapRegisteredImages::calcOverlap( const VirtualPaddedImage &img1,
+                                           const VirtualPaddedImage &img2,
+                                           const int thresh1,
+                                           const int thresh2 )
+{
   try {
-    cv::Mat img1Binary, img2Binary;
-    CVops::binarize_image_via_otsu_threshold( img1, img1Binary,
-                                              _max_BINARY_value );
-    CVops::binarize_image_via_otsu_threshold( img2, img2Binary,
-                                              _max_BINARY_value );
-
-    // "Sum" the two image binaries to calculate the overlap.
-    cv::Mat sumOverlapOfRegisteredBinaries =
-      cv::Mat::zeros(img1Binary.rows, img1Binary.cols, CV_8UC1);
-    CVops::sum_two_binary_images( img1Binary, img2Binary,
-                                  sumOverlapOfRegisteredBinaries );
-
-    cv::Mat sumBinariesInverted;
-    cv::bitwise_not( sumOverlapOfRegisteredBinaries, sumBinariesInverted );
-
-    cv::Mat sumBinariesDilate;
-    CVops::image_dilate( sumBinariesInverted, sumBinariesDilate,
-                         _dilationKernelParams.size,
-                         _dilationKernelParams.type );
-
-    // Save the blob
-    std::vector<int> param(1);
-    param[0] = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
-    cv::imencode(".png", sumBinariesDilate, _vecPngBlob, param);
+    const cv::Rect canvas( cv::Point( 0, 0 ), img1.size() );
+    const cv::Rect region1 = ( img1.borderValue() <= thresh1 ) ? canvas
+                                                               : img1.sourceRect();
+    const cv::Rect region2 = ( img2.borderValue() <= thresh2 ) ? canvas
+                                                               : img2.sourceRect();
+    _canvasSize = img1.size();
+    _overlapRect = region1 & region2;
+    _overlap = BinaryImage();
+    if( _overlapRect.empty() )
+      return;
+
+    _overlap = overlap_bits( img1, img2, thresh1, thresh2, _overlapRect );
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"OverlapRegisteredImages, cannot calc image-crop ROI: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+}
 
+/**
+ * @brief Exact bounding box of the overlap, searched coarse-to-fine.
+ *
+ * Coarse: each block of factor x factor pixels is reduced to the minimum
+ * of each image, and the block is set if both minimums are at most their
+ * thresholds.  Any block holding an overlap pixel is set, so the box of the
+ * set blocks holds the exact box.  If no block is set there is no overlap,
+ * and no full-resolution work is done.  Neither image is materialized.
+ * Every pixel is read once, by the vectorized running minimum; sampling
+ * the blocks would be cheaper but could miss overlap pixels, so the box
+ * would no longer bound the ROI.
+ *
+ * Early rejection: the ROI grows the exact box by the dilation, so it lies
+ * within the overlap region, and then within the coarse box, grown alike.
+ * If either of those fails the ROI thresholds the same exception is thrown
+ * at once (its size is that of the bound, not of the exact ROI).
+ *
+ * Fine: the exact edges are searched inward from the coarse box, one
+ * full-resolution row (or the unresolved ends of a row) at a time, so
+ * only bands along the edges of the coarse box are binarized.
+ *
+ * The overlap bits are not built; getBlob() builds them if requested.
+ *
+ * @param img1 IN padded, same canvas size as img2
+ * @param img2 IN padded, same canvas size as img1
+ * @param thresh1 IN Otsu threshold of img1
+ * @param thresh2 IN Otsu threshold of img2
+ * @param factor IN pixels per side of a coarse block
+ *
+ * @return bounding box of the overlap in overlap coordinates, may be empty
+ * @throw NFRL::Miscue the ROI is bound to be below threshold
+ */
+cv::Rect OverlapRegisteredImages::calcOverlapCoarseToFine(
+    const VirtualPaddedImage &img1, const VirtualPaddedImage &img2,
+    const int thresh1, const int thresh2, const int factor )
+{
+  const cv::Rect canvas( cv::Point( 0, 0 ), img1.size() );
+  const cv::Rect region1 = ( img1.borderValue() <= thresh1 ) ? canvas
+                                                             : img1.sourceRect();
+  const cv::Rect region2 = ( img2.borderValue() <= thresh2 ) ? canvas
+                                                             : img2.sourceRect();
+  _canvasSize = img1.size();
+  _overlapRect = region1 & region2;
+  _overlap = BinaryImage();
+  _coarseFactor = factor;
+  _image1 = img1;
+  _image2 = img2;
+  _thresh1 = thresh1;
+  _thresh2 = thresh2;
+  const cv::Rect R = _overlapRect;
+  if( R.empty() )
+    return cv::Rect();
+  // The ROI lies within the overlap region grown by the dilation, so a thin
+  // region is rejected before any pixel is read.
+  calcRegionOfInterest( cv::Rect( cv::Point( 0, 0 ), R.size() ) );
+
+  // Coarse: minimum of each block, then binarize and AND the blocks.  The
+  // rows of a block are reduced with the vectorized running minimum, so the
+  // scalar work is one pixel per block column.
+  const int bw = ( R.width + factor - 1 ) / factor;
+  const int bh = ( R.height + factor - 1 ) / factor;
+  BinaryImage coarse( cv::Size( bw, bh ) );
+  std::vector<uint8_t> scratch( R.width ), min1( R.width ), min2( R.width );
+  std::vector<uint8_t> pooled1( bw ), pooled2( bw );
+  std::vector<uint64_t> bits1( coarse.wordsPerRow() ), bits2( coarse.wordsPerRow() );
+  auto reduceRow = [&]( const VirtualPaddedImage &img, const int y,
+                         const bool first, std::vector<uint8_t> &mins )
+  {
+    const uint8_t *row = img.rowSpan( y, R.x, R.width, scratch.data() );
+    if( first )
+      std::copy( row, row + R.width, mins.begin() );
+    else
+      Kernels::min_bytes( row, mins.data(), R.width );
+  };
+  for( int by=0; by<bh; by++ )
+  {
+    const int y0 = R.y + by * factor;
+    const int y1 = std::min( y0 + factor, R.y + R.height );
+    for( int y=y0; y<y1; y++ )
+    {
+      reduceRow( img1, y, y == y0, min1 );
+      reduceRow( img2, y, y == y0, min2 );
+    }
+    for( int bx=0; bx<bw; bx++ )
+    {
+      const int x0 = bx * factor;
+      const int x1 = std::min( x0 + factor, R.width );
+      pooled1[bx] = *std::min_element( min1.begin() + x0, min1.begin() + x1 );
+      pooled2[bx] = *std::min_element( min2.begin() + x0, min2.begin() + x1 );
+    }
+    Kernels::pack_at_most( pooled1.data(), bits1.data(), bw, thresh1 );
+    Kernels::pack_at_most( pooled2.data(), bits2.data(), bw, thresh2 );
+    for( size_t w=0; w<bits1.size(); w++ )
+      bits1[w] &= bits2[w];
+    coarse.orRow( by, 0, bits1.data(), bw );
+  }
+  const cv::Rect blocks = coarse.boundingRect();
+  if( blocks.empty() )
+    return cv::Rect();
+  const cv::Rect cand = cv::Rect( blocks.x * factor, blocks.y * factor,
+                                  blocks.width * factor,
+                                  blocks.height * factor ) &
+                        cv::Rect( cv::Point( 0, 0 ), R.size() );
+  // The box of the kept blocks holds the overlap, so a pair whose ROI would
+  // fail the thresholds even grown from that box is rejected before any
+  // full-resolution refinement.
+  calcRegionOfInterest( cand );
+
+  // Fine: first and last overlap pixels of columns [x0, x1) of a row.
+  BinaryImage line( cv::Size( R.width, 1 ) );
+  std::vector<uint64_t> fixedBits( line.wordsPerRow() );
+  auto extent = [&]( const int y, const int x0, const int x1,
+                     int &first, int &last ) -> bool
+  {
+    if( x1 <= x0 )
+      return false;
+    const int n = x1 - x0;
+    const int nWords = ( n + 63 ) / 64;
+    uint64_t *bits = line.row(0);
+    Kernels::pack_at_most( img1.rowSpan( R.y + y, R.x + x0, n, scratch.data() ),
+                           bits, n, thresh1 );
+    Kernels::pack_at_most( img2.rowSpan( R.y + y, R.x + x0, n, scratch.data() ),
+                           fixedBits.data(), n, thresh2 );
+    for( int w=0; w<line.wordsPerRow(); w++ )
+      bits[w] = ( w < nWords ) ? ( bits[w] & fixedBits[w] ) : 0;
+    if( !line.rowExtent( 0, first, last ) )
+      return false;
+    first += x0;
+    last += x0;
+    return true;
+  };
 
-    cv::Mat nonZeroPoints;
-    cv::findNonZero( sumBinariesDilate, nonZeroPoints );
-    _minRect = cv::boundingRect( nonZeroPoints );
-    if( isRegionOfInterestEmpty() )
+  int top{-1}, bottom{-1}, left{0}, right{0}, first, last;
+  for( int y=cand.y; y<cand.y + cand.height && top < 0; y++ )
+  {
+    if( extent( y, cand.x, cand.x + cand.width, first, last ) )
     {
-      throw NFRL::Miscue( "Registered images overlap region is empty." );
+      top = bottom = y;
+      left = first;
+      right = last;
     }
-    std::string errMsg;
-    if( isRegionOfInterestBelowThresh( errMsg ) )
+  }
+  if( top < 0 )
+    return cv::Rect();
+  for( int y=cand.y + cand.height - 1; y>top; y-- )
+  {
+    if( extent( y, cand.x, cand.x + cand.width, first, last ) )
     {
-      throw NFRL::Miscue( errMsg );
+      bottom = y;
+      left = std::min( left, first );
+      right = std::max( right, last );
+      break;
     }
+  }
+  // Only the ends of the rows beyond the edges found so far are searched.
+  for( int y=top + 1; y<bottom; y++ )
+  {
+    if( extent( y, cand.x, left, first, last ) )
+      left = first;
+    if( extent( y, right + 1, cand.x + cand.width, first, last ) )
+      right = last;
+  }
+  return cv::Rect( left, top, right - left + 1, bottom - top + 1 );
+}
 
+/**
+ * @brief Bounding box of the dilated, inverted sum of the binaries.
+ *
+ * The inverted sum is set where the sum is zero.  Rather than dilate it and
+ * collect every set point, the set rows and columns are reduced to their
+ * min and max word by word.  Dilation by a kernel of size k (any shape spans
+ * k pixels along each axis) then grows that box by k on every side, clipped
+ * to the canvas, exactly as the bounding box of the dilated image.
+ *
+ * @param overlapBox IN bounding box of the set bits of the inverted sum, in
+ *                   overlap coordinates
+ *
+ * @throw NFRL::Miscue overlap region is empty or below threshold
+ */
+void OverlapRegisteredImages::calcRegionOfInterest( const cv::Rect &overlapBox )
+{
+  _minRect = cv::Rect();
+  cv::Rect box = overlapBox;
+  if( !box.empty() )
+  {
+    box += _overlapRect.tl();
+    const int k = _dilationKernelParams.size;
+    int x0 = std::max( box.x - k, 0 );
+    int y0 = std::max( box.y - k, 0 );
+    int x1 = std::min( box.br().x - 1 + k, _canvasSize.width - 1 );
+    int y1 = std::min( box.br().y - 1 + k, _canvasSize.height - 1 );
+    _minRect = cv::Rect( x0, y0, x1 - x0 + 1, y1 - y0 + 1 );
   }
-  catch( const cv::Exception& ex ) {
-    std::string err{"OverlapRegisteredImages, cannot calc image-crop ROI: "};
-    err.append( ex.what() );
-    throw NFRL::Miscue( err );
+
+  if( isRegionOfInterestEmpty() )
+  {
+    throw NFRL::Miscue( "Registered images overlap region is empty." );
+  }
+  std::string errMsg;
+  if( isRegionOfInterestBelowThresh( errMsg ) )
+  {
+    throw NFRL::Miscue( errMsg );
   }
 }
 
@@ -195,11 +508,88 @@ std::string OverlapRegisteredImages::getStructuringElementParams()
 /**
  * @brief Image used to calculate the common, ROI crop coordinates.
  *
+ * The blob is the inverted, dilated sum of the binaries.  It is not needed
+ * by the ROI calculation, so it is only rendered when requested.  The
+ * rectangle kernel is dilated in bits; only the overlap region grown by the
+ * kernel is dilated, the rest of the canvas is black.
+ *
+ * @return blob image, empty if no images were overlapped
+ * @throw NFRL::Miscue cannot render blob
+ */
+cv::Mat OverlapRegisteredImages::getBlob() const
+{
+  cv::Mat sumBinariesDilate;
+  if( _canvasSize.area() == 0 )
+    return sumBinariesDilate;
+
+  try {
+    const int k = std::max( _dilationKernelParams.size, 0 );
+    const cv::Rect canvas( cv::Point( 0, 0 ), _canvasSize );
+    const cv::Rect grown = cv::Rect( _overlapRect.x - k, _overlapRect.y - k,
+                                     _overlapRect.width + 2*k,
+                                     _overlapRect.height + 2*k ) & canvas;
+
+    sumBinariesDilate = cv::Mat::zeros( _canvasSize, CV_8UC1 );
+    if( _overlapRect.empty() )
+      return sumBinariesDilate;
+
+    // The coarse-to-fine search does not build the overlap bits.
+    BinaryImage built;
+    if( _overlap.empty() )
+      built = overlap_bits( _image1, _image2, _thresh1, _thresh2, _overlapRect );
+    const BinaryImage &overlap = _overlap.empty() ? built : _overlap;
+
+    BinaryImage blob( grown.size() );
+    const cv::Point at = _overlapRect.tl() - grown.tl();
+    for( int y=0; y<_overlapRect.height; y++ )
+      blob.orRow( at.y + y, at.x, overlap.row(y), _overlapRect.width );
+
+    cv::Mat region = sumBinariesDilate( grown );
+    if( _dilationKernelParams.type == cv::MORPH_RECT )
+    {
+      blob.dilate( k ).toMat().copyTo( region );
+    }
+    else
+    {
+      CVops::image_dilate( blob.toMat(), region,
+                           _dilationKernelParams.size,
+                           _dilationKernelParams.type );
+    }
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"OverlapRegisteredImages, cannot save blob: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+  return sumBinariesDilate;
+}
+
+
+/**
+ * @brief Image used to calculate the common, ROI crop coordinates, encoded
+ *  as a PNG.
+ *
  * @return vector of unsigned bytes
+ * @throw NFRL::Miscue cannot render or encode blob
  */
 std::vector<uint8_t> OverlapRegisteredImages::getPngBlob() const
 {
-  return _vecPngBlob;
+  std::vector<uint8_t> vecPngBlob;
+  cv::Mat blob = getBlob();
+  if( blob.empty() )
+    return vecPngBlob;
+
+  try {
+    std::vector<int> param(1);
+    param[0] = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
+    cv::imencode(".png", blob, vecPngBlob, param);
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"OverlapRegisteredImages, cannot save blob: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+  return vecPngBlob;
 }
 
 
@@ -224,6 +614,11 @@ std::string OverlapRegisteredImages::to_s()
   s3 += "    area:   " + std::to_string(_minRect.area()) + "\n";
 
   std::string s4{_dilationKernelParams.to_s()};
+  if( _coarseFactor > 1 )
+  {
+    s4 += " * Coarse-to-fine search, block size: " +
+          std::to_string( _coarseFactor ) + "\n";
+  }
 
   return s1 + s2 + s3 + s4;
 }
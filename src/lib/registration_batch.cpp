@@ -0,0 +1,365 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "registration_batch.h"
+#include "exceptions.h"
+#include "task_graph.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+#ifdef USE_OPENCV
+  namespace NFRL {
+#else
+  namespace NFRL_ITL {
+#endif
+
+namespace {
+
+/** @brief Job indices of one worker: the owner takes from the front, the
+ *   other workers steal from the back. */
+class JobQueue
+{
+private:
+  std::deque<int> _jobs;
+  std::mutex _mtx;
+
+public:
+  /** @brief Add a job at the back. */
+  void push( const int job )
+  {
+    std::lock_guard<std::mutex> lock( _mtx );
+    _jobs.push_back( job );
+  }
+
+  /** @brief Take the next job of the owner, false if none. */
+  bool pop( int &job )
+  {
+    std::lock_guard<std::mutex> lock( _mtx );
+    if( _jobs.empty() )
+      return false;
+    job = _jobs.front();
+    _jobs.pop_front();
+    return true;
+  }
+
+  /** @brief Take the last job for another worker, false if none. */
+  bool steal( int &job )
+  {
+    std::lock_guard<std::mutex> lock( _mtx );
+    if( _jobs.empty() )
+      return false;
+    job = _jobs.back();
+    _jobs.pop_back();
+    return true;
+  }
+};
+
+/** @brief Worker threads, joined when the pool goes out of scope, even if
+ *   starting a thread throws. */
+class WorkerPool
+{
+private:
+  std::vector<std::thread> _threads;
+
+public:
+  ~WorkerPool()
+  {
+    for( std::thread &t : _threads )
+      t.join();
+  }
+
+  /** @brief Start a thread. */
+  template<typename F, typename... Args>
+  void start( F &&f, Args&&... args )
+  {
+    _threads.emplace_back( std::forward<F>( f ), std::forward<Args>( args )... );
+  }
+};
+
+/** @brief OpenCV's process-wide thread count, set for the scope of the
+ *   guard and then restored; no change if not enabled. */
+class OpenCvThreadLimit
+{
+private:
+  bool _enabled{false};
+  int _saved{0};
+
+public:
+  OpenCvThreadLimit( const bool enabled, const int threads )
+    : _enabled( enabled )
+  {
+    if( _enabled )
+    {
+      _saved = cv::getNumThreads();
+      cv::setNumThreads( threads );
+    }
+  }
+  ~OpenCvThreadLimit()
+  {
+    if( _enabled )
+      cv::setNumThreads( _saved );
+  }
+};
+
+/** @brief Reusable input buffers of one worker; the working buffers of a
+ *   registration belong to its Registrator. */
+struct Scratch
+{
+  /** @brief Control points of the current job. */
+  std::vector<int> points;
+  /** @brief Bytes of the Moving image file, reused once the Registrator
+   *   has released them. */
+  std::shared_ptr<std::vector<uint8_t>> movingFile;
+  /** @brief Bytes of the Fixed image file, reused likewise. */
+  std::shared_ptr<std::vector<uint8_t>> fixedFile;
+};
+
+/**
+ * @brief Read a file into a buffer, reusing its capacity if no one else
+ *  holds it.
+ *
+ * @throw NFRL::Miscue cannot read the file
+ */
+Registrator::SharedBuffer read_file( const std::string &path,
+                                     std::shared_ptr<std::vector<uint8_t>> &buf )
+{
+  if( !buf || buf.use_count() > 1 )
+    buf = std::make_shared<std::vector<uint8_t>>();
+  std::ifstream ifs( path, std::ios::binary | std::ios::ate );
+  if( !ifs )
+    throw NFRL::Miscue( "cannot read image file: " + path );
+  const std::streamoff size = ifs.tellg();
+  buf->resize( static_cast<size_t>( std::max<std::streamoff>( size, 0 ) ) );
+  ifs.seekg( 0 );
+  if( !ifs.read( reinterpret_cast<char*>( buf->data() ), size ) )
+    throw NFRL::Miscue( "cannot read image file: " + path );
+  return buf;
+}
+
+/**
+ * @brief Register one job and move its selected outputs into the result.
+ *
+ * @throw NFRL::Miscue the images cannot be read or registered
+ */
+void register_job( const RegistrationBatch::Job &job,
+                   const Registrator::RegistrationOptions &options,
+                   Scratch &scratch, RegistrationBatch::Result &result )
+{
+  scratch.points = job.correspondingPoints;
+
+  std::unique_ptr<Registrator> registrator;
+  if( job.preparedMoving )
+  {
+    std::shared_ptr<const Registrator::PreparedImage> fixed =
+      job.preparedFixed;
+    if( !fixed )
+    {
+      fixed = std::make_shared<const Registrator::PreparedImage>(
+                job.fixed ? job.fixed
+                          : read_file( job.fixedPath, scratch.fixedFile ) );
+    }
+    registrator.reset( new Registrator( job.preparedMoving, fixed,
+                                        scratch.points, result.metadata,
+                                        job.outputs ) );
+  }
+  else if( job.preparedFixed )
+  {
+    Registrator::SharedBuffer moving = job.moving ? job.moving
+      : read_file( job.movingPath, scratch.movingFile );
+    registrator.reset( new Registrator( std::move( moving ), job.preparedFixed,
+                                        scratch.points, result.metadata,
+                                        job.outputs ) );
+  }
+  else
+  {
+    Registrator::SharedBuffer moving = job.moving ? job.moving
+      : read_file( job.movingPath, scratch.movingFile );
+    Registrator::SharedBuffer fixed = job.fixed ? job.fixed
+      : read_file( job.fixedPath, scratch.fixedFile );
+    registrator.reset( new Registrator( std::move( moving ), std::move( fixed ),
+                                        scratch.points, result.metadata,
+                                        job.outputs ) );
+  }
+  registrator->performRegistration( options );
+  registrator->encodeSelectedOutputs();
+  registrator->getMetadata( result.registrationMetadata );
+
+  typedef Registrator::OutputArtifact Artifact;
+  const std::pair<Artifact, std::vector<uint8_t> (Registrator::*)()> outputs[] = {
+    { Registrator::croppedRegisteredImage, &Registrator::releaseCroppedRegisteredImage },
+    { Registrator::croppedFixedImage, &Registrator::releaseCroppedFixedImage },
+    { Registrator::colorOverlaidImage, &Registrator::releaseColorOverlaidRegisteredImages },
+    { Registrator::paddedFixedImage, &Registrator::releasePaddedFixedImg },
+    { Registrator::paddedRegisteredMovingImage, &Registrator::releasePaddedRegisteredMovingImg },
+    { Registrator::overlapBlob, &Registrator::releasePngBlob } };
+  for( const auto &output : outputs )
+  {
+    if( job.outputs & output.first )
+      result.images[output.first] = ( registrator.get()->*output.second )();
+  }
+  result.success = true;
+}
+
+}   // END anonymous namespace
+
+
+/** @brief Initialization function that resets all values. */
+void RegistrationBatch::Init()
+{
+  _jobCount = 0;
+  _stolenCount = 0;
+}
+
+/** @brief Default constructor: default options, one worker per hardware
+ *   thread.  Calls Init(). */
+RegistrationBatch::RegistrationBatch()
+  : _workers( NFRL::TaskGraph::threadBudget( 0 ) )
+{
+  Init();
+}
+
+/**
+ * @param options IN options of every registration
+ * @param workers IN worker threads, the calling thread included; 0 for all
+ *                hardware threads
+ * @param innerThreads IN threads of each registration (it replaces
+ *                     RegistrationOptions::threads); 1 so that the workers
+ *                     alone use the cores
+ * @param limitOpenCvThreads IN also set OpenCV's process-wide thread count
+ *                           to innerThreads during each run, see run()
+ */
+RegistrationBatch::RegistrationBatch(
+  const Registrator::RegistrationOptions &options,
+  const int workers, const int innerThreads, const bool limitOpenCvThreads )
+  : _options( options ), _workers( NFRL::TaskGraph::threadBudget( workers ) ),
+    _limitOpenCvThreads( limitOpenCvThreads )
+{
+  _options.threads = NFRL::TaskGraph::threadBudget( innerThreads );
+  Init();
+}
+
+/**
+ * @brief Register every job.
+ *
+ * If enabled (see the constructor), while more than one worker runs,
+ * OpenCV's own parallel loops (e.g., of the tiled engine) are limited to
+ * the threads of each registration, so the workers and OpenCV do not
+ * oversubscribe the cores.  OpenCV's thread count is process-wide, so this
+ * also limits other OpenCV users of the process until the run returns (or
+ * throws), when it is restored.
+ *
+ * @param jobs IN pairs of images to register
+ *
+ * @return result of each job, in the order of the jobs
+ */
+std::vector<RegistrationBatch::Result>
+RegistrationBatch::run( const std::vector<Job> &jobs )
+{
+  Init();
+  _jobCount = static_cast<int>( jobs.size() );
+  std::vector<Result> results( jobs.size() );
+  const int workers = std::max( 1, std::min( _workers, _jobCount ) );
+
+  std::vector<JobQueue> queues( workers );
+  for( int w=0; w<workers; w++ )
+  {
+    const int first = static_cast<int>( static_cast<long long>( _jobCount ) * w / workers );
+    const int end = static_cast<int>( static_cast<long long>( _jobCount ) * ( w + 1 ) / workers );
+    for( int j=first; j<end; j++ )
+      queues[w].push( j );
+  }
+
+  std::atomic<int> stolen{0};
+  auto worker = [&]( const int w )
+  {
+    Scratch scratch;
+    int j;
+    while( true )
+    {
+      if( !queues[w].pop( j ) )
+      {
+        bool found = false;
+        for( int v=1; v<workers && !found; v++ )
+          found = queues[( w + v ) % workers].steal( j );
+        if( !found )
+          return;
+        stolen++;
+      }
+
+      Result &result = results[j];
+      try {
+        register_job( jobs[j], _options, scratch, result );
+      }
+      catch( const std::exception &e ) {
+        result.success = false;
+        result.images.clear();
+        result.error = e.what();
+      }
+    }
+  };
+
+  {
+    // The pool is declared after the limit, so its threads are joined
+    // before the thread count is restored.
+    OpenCvThreadLimit limit( _limitOpenCvThreads && workers > 1,
+                             _options.threads );
+    WorkerPool pool;
+    for( int w=1; w<workers; w++ )
+      pool.start( worker, w );
+    worker( 0 );
+  }
+
+  _stolenCount = stolen;
+  return results;
+}
+
+/**
+ * @return workers, threads per registration, and job counts of the last run
+ *         in print format
+ */
+std::string RegistrationBatch::to_s() const
+{
+  std::string s{"RegistrationBatch:\n"};
+  s += " * Workers: " + std::to_string( _workers ) + "\n";
+  s += " * Threads per registration: " + std::to_string( _options.threads ) + "\n";
+  s += " * Jobs: " + std::to_string( _jobCount ) + ", stolen: " +
+       std::to_string( _stolenCount ) + "\n";
+  return s;
+}
+
+}   // END namespace
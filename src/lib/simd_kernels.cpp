@@ -0,0 +1,669 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define NFRL_SIMD_X86 1
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #endif
+#else
+  #define NFRL_SIMD_X86 0
+#endif
+
+// GCC and Clang compile each variant for its instruction set; MSVC allows
+// any intrinsic without target flags.
+#if NFRL_SIMD_X86 && ( defined(__GNUC__) || defined(__clang__) )
+  #define NFRL_TARGET(isa) __attribute__((target(isa)))
+#else
+  #define NFRL_TARGET(isa)
+#endif
+
+
+namespace Kernels {
+
+namespace {
+
+/** @brief Highest level supported by both the CPU and the OS. */
+SimdLevel detect()
+{
+#if NFRL_SIMD_X86
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" ) )
+    return avx512;
+  if( __builtin_cpu_supports( "avx2" ) )
+    return avx2;
+  if( __builtin_cpu_supports( "sse2" ) )
+    return sse2;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid( info, 0 );
+  const int maxLeaf = info[0];
+  __cpuid( info, 1 );
+  const bool hasSse2 = ( info[3] & (1 << 26) ) != 0;
+  const bool osxsave = ( info[2] & (1 << 27) ) != 0;
+  const unsigned long long xcr0 = osxsave ? _xgetbv( 0 ) : 0;
+  bool hasAvx2{false}, hasAvx512{false};
+  if( maxLeaf >= 7 )
+  {
+    __cpuidex( info, 7, 0 );
+    hasAvx2 = ( info[1] & (1 << 5) ) != 0 && ( xcr0 & 0x06 ) == 0x06;
+    hasAvx512 = ( info[1] & (1 << 16) ) != 0 && ( info[1] & (1 << 30) ) != 0 &&
+                ( xcr0 & 0xE6 ) == 0xE6;
+  }
+  if( hasAvx512 ) return avx512;
+  if( hasAvx2 ) return avx2;
+  if( hasSse2 ) return sse2;
+#endif
+#endif
+  return scalar;
+}
+
+/** @brief The CPU has SSSE3, needed by the interleave of overlay_tint(). */
+bool has_ssse3()
+{
+#if NFRL_SIMD_X86
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports( "ssse3" );
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid( info, 1 );
+  return ( info[2] & (1 << 9) ) != 0;
+#endif
+#endif
+  return false;
+}
+
+/** @brief Level used by the kernels; may be lowered for verification. */
+std::atomic<int> &active_level()
+{
+  static std::atomic<int> level{ static_cast<int>( detected_simd_level() ) };
+  return level;
+}
+
+
+// ---- Scalar reference ------------------------------------------------------
+
+void min_bytes_scalar( const uint8_t *src, uint8_t *dst, size_t n )
+{
+  for( size_t i=0; i<n; i++ )
+    dst[i] = std::min( dst[i], src[i] );
+}
+
+// Bit i of word i/64 is set where src[i] <= thresh; the rest are clear.
+void pack_at_most_scalar( const uint8_t *src, uint64_t *dst, size_t n,
+                          int thresh )
+{
+  for( size_t w=0; w*64 < n; w++ )
+  {
+    const size_t end = std::min( n, w*64 + 64 );
+    uint64_t word{0};
+    for( size_t i=w*64; i<end; i++ )
+      word |= static_cast<uint64_t>( src[i] <= thresh ) << ( i & 63 );
+    dst[w] = word;
+  }
+}
+
+// Tinted, blended overlay of a Moving (green) and Fixed (magenta) pixel:
+// ( L(m), L(f), L(m) ) with L(v) = (v + 255) / 2 rounded half to even, the
+// blend of ( m, 255, m ) and ( 255, f, 255 ) by addWeighted( 0.5, 0.5 ).
+inline uint8_t tint( uint8_t v )
+{
+  const int sum = v + 255;
+  const int q = sum >> 1;
+  return static_cast<uint8_t>( q + ( sum & q & 1 ) );
+}
+
+void overlay_tint_scalar( const uint8_t *moving, const uint8_t *fixed,
+                          uint8_t *dst, size_t n )
+{
+  for( size_t i=0; i<n; i++ )
+  {
+    const uint8_t m = tint( moving[i] );
+    dst[3*i]     = m;
+    dst[3*i + 1] = tint( fixed[i] );
+    dst[3*i + 2] = m;
+  }
+}
+
+// 4-bit Moving level in the high nibble, 4-bit Fixed level in the low.
+void overlay_palette_index_scalar( const uint8_t *moving, const uint8_t *fixed,
+                                   uint8_t *dst, size_t n )
+{
+  for( size_t i=0; i<n; i++ )
+    dst[i] = static_cast<uint8_t>( ( moving[i] & 0xF0 ) | ( fixed[i] >> 4 ) );
+}
+
+// Source pixel, or the border value outside the source.
+inline int warp_pixel( const WarpSource &src, int x, int y )
+{
+  if( static_cast<unsigned>( x ) >= static_cast<unsigned>( src.width ) ||
+      static_cast<unsigned>( y ) >= static_cast<unsigned>( src.height ) )
+    return src.border;
+  return src.data[ static_cast<size_t>( y ) * src.step + x ];
+}
+
+// Bilinear blend with 8-bit weights, rounded; exact integer arithmetic.
+inline uint8_t lerp2( int p00, int p01, int p10, int p11, int fx, int fy )
+{
+  const int top = ( p00 << WARP_WEIGHT_BITS ) + ( p01 - p00 ) * fx;
+  const int bot = ( p10 << WARP_WEIGHT_BITS ) + ( p11 - p10 ) * fx;
+  const int v = ( top << WARP_WEIGHT_BITS ) + ( bot - top ) * fy;
+  return static_cast<uint8_t>( ( v + ( 1 << ( 2*WARP_WEIGHT_BITS - 1 ) ) )
+                               >> ( 2*WARP_WEIGHT_BITS ) );
+}
+
+void warp_bilinear_scalar( const WarpSource &src, const int *adelta,
+                           const int *bdelta, int X0, int Y0, uint8_t *dst,
+                           size_t n )
+{
+  const int shift = WARP_COORD_BITS - WARP_WEIGHT_BITS;
+  const int mask = ( 1 << WARP_WEIGHT_BITS ) - 1;
+  for( size_t i=0; i<n; i++ )
+  {
+    const int X = ( X0 + adelta[i] ) >> shift;
+    const int Y = ( Y0 + bdelta[i] ) >> shift;
+    const int ix = X >> WARP_WEIGHT_BITS, iy = Y >> WARP_WEIGHT_BITS;
+    const int fx = X & mask, fy = Y & mask;
+    if( static_cast<unsigned>( ix ) < static_cast<unsigned>( src.width - 1 ) &&
+        static_cast<unsigned>( iy ) < static_cast<unsigned>( src.height - 1 ) )
+    {
+      const uint8_t *p = src.data + static_cast<size_t>( iy ) * src.step + ix;
+      dst[i] = lerp2( p[0], p[1], p[src.step], p[src.step + 1], fx, fy );
+    }
+    else
+    {
+      dst[i] = lerp2( warp_pixel( src, ix, iy ), warp_pixel( src, ix + 1, iy ),
+                      warp_pixel( src, ix, iy + 1 ),
+                      warp_pixel( src, ix + 1, iy + 1 ), fx, fy );
+    }
+  }
+}
+
+void warp_nearest_scalar( const WarpSource &src, const int *adelta,
+                          const int *bdelta, int X0, int Y0, uint8_t *dst,
+                          size_t n )
+{
+  for( size_t i=0; i<n; i++ )
+  {
+    dst[i] = static_cast<uint8_t>(
+      warp_pixel( src, ( X0 + adelta[i] ) >> WARP_COORD_BITS,
+                       ( Y0 + bdelta[i] ) >> WARP_COORD_BITS ) );
+  }
+}
+
+
+#if NFRL_SIMD_X86
+
+// ---- SSE2 ------------------------------------------------------------------
+
+NFRL_TARGET("sse2")
+size_t min_bytes_sse2( const uint8_t *src, uint8_t *dst, size_t n )
+{
+  size_t i{0};
+  for( ; i + 16 <= n; i += 16 )
+  {
+    __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+    __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( dst + i ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ),
+                      _mm_min_epu8( a, b ) );
+  }
+  return i;
+}
+
+NFRL_TARGET("sse2")
+size_t pack_at_most_sse2( const uint8_t *src, uint64_t *dst, size_t n,
+                          int thresh )
+{
+  // src <= thresh  <=>  min( src, thresh ) == src, for 0 <= thresh < 255
+  const __m128i t = _mm_set1_epi8( static_cast<char>( thresh ) );
+  size_t i{0};
+  for( ; i + 64 <= n; i += 64 )
+  {
+    uint64_t word{0};
+    for( int k=0; k<4; k++ )
+    {
+      __m128i v = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>( src + i + 16*k ) );
+      __m128i le = _mm_cmpeq_epi8( _mm_min_epu8( v, t ), v );
+      word |= static_cast<uint64_t>(
+                static_cast<uint16_t>( _mm_movemask_epi8( le ) ) ) << ( 16*k );
+    }
+    dst[i/64] = word;
+  }
+  return i;
+}
+
+NFRL_TARGET("sse2")
+size_t overlay_palette_index_sse2( const uint8_t *moving, const uint8_t *fixed,
+                                   uint8_t *dst, size_t n )
+{
+  const __m128i hi = _mm_set1_epi8( static_cast<char>( 0xF0 ) );
+  const __m128i lo = _mm_set1_epi8( 0x0F );
+  size_t i{0};
+  for( ; i + 16 <= n; i += 16 )
+  {
+    __m128i m = _mm_loadu_si128( reinterpret_cast<const __m128i*>( moving + i ) );
+    __m128i f = _mm_loadu_si128( reinterpret_cast<const __m128i*>( fixed + i ) );
+    __m128i idx = _mm_or_si128( _mm_and_si128( m, hi ),
+                                _mm_and_si128( _mm_srli_epi16( f, 4 ), lo ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), idx );
+  }
+  return i;
+}
+
+
+// ---- SSSE3 -----------------------------------------------------------------
+
+NFRL_TARGET("ssse3")
+size_t overlay_tint_ssse3( const uint8_t *moving, const uint8_t *fixed,
+                           uint8_t *dst, size_t n )
+{
+  const __m128i white = _mm_set1_epi8( -1 );
+  const __m128i one = _mm_set1_epi8( 1 );
+  // Output bytes 16k..16k+15 of 16 interleaved pixels: channel 1 from the
+  // Fixed level, channels 0 and 2 from the Moving level (-128 clears).
+  const __m128i mM0 = _mm_setr_epi8( 0, -128, 0, 1, -128, 1, 2, -128, 2, 3, -128, 3, 4, -128, 4, 5 );
+  const __m128i mF0 = _mm_setr_epi8( -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128 );
+  const __m128i mM1 = _mm_setr_epi8( -128, 5, 6, -128, 6, 7, -128, 7, 8, -128, 8, 9, -128, 9, 10, -128 );
+  const __m128i mF1 = _mm_setr_epi8( 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10 );
+  const __m128i mM2 = _mm_setr_epi8( 10, 11, -128, 11, 12, -128, 12, 13, -128, 13, 14, -128, 14, 15, -128, 15 );
+  const __m128i mF2 = _mm_setr_epi8( -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128 );
+  size_t i{0};
+  for( ; i + 16 <= n; i += 16 )
+  {
+    __m128i m = _mm_loadu_si128( reinterpret_cast<const __m128i*>( moving + i ) );
+    __m128i f = _mm_loadu_si128( reinterpret_cast<const __m128i*>( fixed + i ) );
+    // L(v) = avg( v, 255 ) rounded half to even: avg - ( ~v & avg & 1 )
+    __m128i avgM = _mm_avg_epu8( m, white );
+    __m128i avgF = _mm_avg_epu8( f, white );
+    __m128i lm = _mm_sub_epi8( avgM, _mm_and_si128( _mm_andnot_si128( m, avgM ), one ) );
+    __m128i lf = _mm_sub_epi8( avgF, _mm_and_si128( _mm_andnot_si128( f, avgF ), one ) );
+
+    __m128i *out = reinterpret_cast<__m128i*>( dst + 3*i );
+    _mm_storeu_si128( out,     _mm_or_si128( _mm_shuffle_epi8( lm, mM0 ),
+                                             _mm_shuffle_epi8( lf, mF0 ) ) );
+    _mm_storeu_si128( out + 1, _mm_or_si128( _mm_shuffle_epi8( lm, mM1 ),
+                                             _mm_shuffle_epi8( lf, mF1 ) ) );
+    _mm_storeu_si128( out + 2, _mm_or_si128( _mm_shuffle_epi8( lm, mM2 ),
+                                             _mm_shuffle_epi8( lf, mF2 ) ) );
+  }
+  return i;
+}
+
+
+// ---- AVX2 ------------------------------------------------------------------
+
+NFRL_TARGET("avx2")
+size_t min_bytes_avx2( const uint8_t *src, uint8_t *dst, size_t n )
+{
+  size_t i{0};
+  for( ; i + 32 <= n; i += 32 )
+  {
+    __m256i a = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) );
+    __m256i b = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( dst + i ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dst + i ),
+                         _mm256_min_epu8( a, b ) );
+  }
+  return i;
+}
+
+NFRL_TARGET("avx2")
+size_t pack_at_most_avx2( const uint8_t *src, uint64_t *dst, size_t n,
+                          int thresh )
+{
+  const __m256i t = _mm256_set1_epi8( static_cast<char>( thresh ) );
+  size_t i{0};
+  for( ; i + 64 <= n; i += 64 )
+  {
+    __m256i lo = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) );
+    __m256i hi = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i + 32 ) );
+    uint32_t mlo = static_cast<uint32_t>( _mm256_movemask_epi8(
+                     _mm256_cmpeq_epi8( _mm256_min_epu8( lo, t ), lo ) ) );
+    uint32_t mhi = static_cast<uint32_t>( _mm256_movemask_epi8(
+                     _mm256_cmpeq_epi8( _mm256_min_epu8( hi, t ), hi ) ) );
+    dst[i/64] = static_cast<uint64_t>( mlo ) | ( static_cast<uint64_t>( mhi ) << 32 );
+  }
+  return i;
+}
+
+// Eight pixels at a time where all four neighbors of every pixel are inside
+// the source (a 32-bit gather reads 4 bytes, so the last 3 columns are left
+// to the scalar path); any other group of eight is done by the scalar path.
+NFRL_TARGET("avx2")
+size_t warp_bilinear_avx2( const WarpSource &src, const int *adelta,
+                           const int *bdelta, int X0, int Y0, uint8_t *dst,
+                           size_t n )
+{
+  const int shift = WARP_COORD_BITS - WARP_WEIGHT_BITS;
+  const __m256i x0 = _mm256_set1_epi32( X0 ), y0 = _mm256_set1_epi32( Y0 );
+  const __m256i mask = _mm256_set1_epi32( ( 1 << WARP_WEIGHT_BITS ) - 1 );
+  const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+  const __m256i minusOne = _mm256_set1_epi32( -1 );
+  const __m256i xLimit = _mm256_set1_epi32( src.width - 3 );
+  const __m256i yLimit = _mm256_set1_epi32( src.height - 1 );
+  const __m256i step = _mm256_set1_epi32( static_cast<int>( src.step ) );
+  const __m256i half = _mm256_set1_epi32( 1 << ( 2*WARP_WEIGHT_BITS - 1 ) );
+  const int *top = reinterpret_cast<const int*>( src.data );
+  const int *bot = reinterpret_cast<const int*>( src.data + src.step );
+  size_t i{0};
+  for( ; i + 8 <= n; i += 8 )
+  {
+    __m256i X = _mm256_srai_epi32( _mm256_add_epi32( x0,
+                  _mm256_loadu_si256( reinterpret_cast<const __m256i*>( adelta + i ) ) ), shift );
+    __m256i Y = _mm256_srai_epi32( _mm256_add_epi32( y0,
+                  _mm256_loadu_si256( reinterpret_cast<const __m256i*>( bdelta + i ) ) ), shift );
+    __m256i ix = _mm256_srai_epi32( X, WARP_WEIGHT_BITS );
+    __m256i iy = _mm256_srai_epi32( Y, WARP_WEIGHT_BITS );
+    __m256i inside = _mm256_and_si256(
+      _mm256_and_si256( _mm256_cmpgt_epi32( ix, minusOne ),
+                        _mm256_cmpgt_epi32( xLimit, ix ) ),
+      _mm256_and_si256( _mm256_cmpgt_epi32( iy, minusOne ),
+                        _mm256_cmpgt_epi32( yLimit, iy ) ) );
+    if( _mm256_movemask_epi8( inside ) != -1 )
+    {
+      warp_bilinear_scalar( src, adelta + i, bdelta + i, X0, Y0, dst + i, 8 );
+      continue;
+    }
+    __m256i fx = _mm256_and_si256( X, mask );
+    __m256i fy = _mm256_and_si256( Y, mask );
+    __m256i offset = _mm256_add_epi32( _mm256_mullo_epi32( iy, step ), ix );
+    __m256i g0 = _mm256_i32gather_epi32( top, offset, 1 );
+    __m256i g1 = _mm256_i32gather_epi32( bot, offset, 1 );
+    __m256i p00 = _mm256_and_si256( g0, byteMask );
+    __m256i p01 = _mm256_and_si256( _mm256_srli_epi32( g0, 8 ), byteMask );
+    __m256i p10 = _mm256_and_si256( g1, byteMask );
+    __m256i p11 = _mm256_and_si256( _mm256_srli_epi32( g1, 8 ), byteMask );
+    __m256i t = _mm256_add_epi32( _mm256_slli_epi32( p00, WARP_WEIGHT_BITS ),
+                  _mm256_mullo_epi32( _mm256_sub_epi32( p01, p00 ), fx ) );
+    __m256i b = _mm256_add_epi32( _mm256_slli_epi32( p10, WARP_WEIGHT_BITS ),
+                  _mm256_mullo_epi32( _mm256_sub_epi32( p11, p10 ), fx ) );
+    __m256i v = _mm256_add_epi32( _mm256_slli_epi32( t, WARP_WEIGHT_BITS ),
+                  _mm256_mullo_epi32( _mm256_sub_epi32( b, t ), fy ) );
+    v = _mm256_srli_epi32( _mm256_add_epi32( v, half ), 2*WARP_WEIGHT_BITS );
+    // Lanes 0-3 land in bytes 0-3, lanes 4-7 in bytes 16-19.
+    v = _mm256_packus_epi16( _mm256_packus_epi32( v, v ), v );
+    const int lo = _mm256_cvtsi256_si32( v );
+    const int hi = _mm256_extract_epi32( v, 4 );
+    std::memcpy( dst + i, &lo, 4 );
+    std::memcpy( dst + i + 4, &hi, 4 );
+  }
+  return i;
+}
+
+
+// ---- AVX-512 (BW) ----------------------------------------------------------
+
+NFRL_TARGET("avx512f,avx512bw")
+size_t min_bytes_avx512( const uint8_t *src, uint8_t *dst, size_t n )
+{
+  size_t i{0};
+  for( ; i + 64 <= n; i += 64 )
+  {
+    _mm512_storeu_si512( dst + i,
+                         _mm512_min_epu8( _mm512_loadu_si512( src + i ),
+                                          _mm512_loadu_si512( dst + i ) ) );
+  }
+  return i;
+}
+
+NFRL_TARGET("avx512f,avx512bw")
+size_t pack_at_most_avx512( const uint8_t *src, uint64_t *dst, size_t n,
+                            int thresh )
+{
+  const __m512i t = _mm512_set1_epi8( static_cast<char>( thresh ) );
+  size_t i{0};
+  for( ; i + 64 <= n; i += 64 )
+    dst[i/64] = _mm512_cmple_epu8_mask( _mm512_loadu_si512( src + i ), t );
+  return i;
+}
+
+#endif   // NFRL_SIMD_X86
+
+}   // END anonymous namespace
+
+
+/**
+ * @brief Highest instruction-set level supported by this CPU (and OS).
+ *
+ * @return detected level, scalar for non-x86 builds
+ */
+SimdLevel detected_simd_level()
+{
+  static const SimdLevel level = detect();
+  return level;
+}
+
+/**
+ * @return level currently used by the kernels
+ */
+SimdLevel simd_level()
+{
+  return static_cast<SimdLevel>( active_level().load() );
+}
+
+/**
+ * @brief Lower (or restore) the level used by the kernels, e.g., to verify
+ *  a level against the scalar reference.
+ *
+ * @param level IN requested level, limited to the detected level
+ *
+ * @return level now in use
+ */
+SimdLevel set_simd_level( const SimdLevel level )
+{
+  SimdLevel used = ( level < detected_simd_level() ) ? level
+                                                     : detected_simd_level();
+  active_level().store( static_cast<int>( used ) );
+  return used;
+}
+
+/**
+ * @param level IN instruction-set level
+ *
+ * @return name of the level for metadata and logging
+ */
+const char* simd_level_name( const SimdLevel level )
+{
+  switch( level )
+  {
+    case avx512 : return "AVX-512";
+    case avx2   : return "AVX2";
+    case sse2   : return "SSE2";
+    case scalar :
+    default     : return "scalar";
+  }
+}
+
+/**
+ * @brief Running minimum of rows, as OpenCV min( src, dst, dst ).
+ *
+ * @param src IN pixels
+ * @param dst IN/OUT pixels, replaced by the minimum of each pair
+ * @param n IN number of pixels
+ */
+void min_bytes( const uint8_t *src, uint8_t *dst, const size_t n )
+{
+  size_t done{0};
+#if NFRL_SIMD_X86
+  switch( simd_level() )
+  {
+    case avx512 : done = min_bytes_avx512( src, dst, n ); break;
+    case avx2   : done = min_bytes_avx2( src, dst, n ); break;
+    case sse2   : done = min_bytes_sse2( src, dst, n ); break;
+    default     : break;
+  }
+#endif
+  min_bytes_scalar( src + done, dst + done, n - done );
+}
+
+/**
+ * @brief Pack a row into bits: one bit per pixel, set where the pixel is at
+ *  most the threshold (i.e., black after a binary threshold).
+ *
+ * Bit i of word i/64 holds pixel i; bits past n in the last word are clear.
+ *
+ * @param src IN pixels
+ * @param dst OUT (n + 63) / 64 words
+ * @param n IN number of pixels
+ * @param thresh IN threshold
+ */
+void pack_at_most( const uint8_t *src, uint64_t *dst, const size_t n,
+                   const int thresh )
+{
+  size_t done{0};
+  if( thresh < 0 || thresh >= 255 )
+  {
+    const uint64_t value = ( thresh < 0 ) ? 0 : ~uint64_t{0};
+    for( size_t w=0; w*64 < n; w++ )
+      dst[w] = ( n - w*64 >= 64 ) ? value : value & ( ( uint64_t{1} << ( n - w*64 ) ) - 1 );
+    return;
+  }
+#if NFRL_SIMD_X86
+  switch( simd_level() )
+  {
+    case avx512 : done = pack_at_most_avx512( src, dst, n, thresh ); break;
+    case avx2   : done = pack_at_most_avx2( src, dst, n, thresh ); break;
+    case sse2   : done = pack_at_most_sse2( src, dst, n, thresh ); break;
+    default     : break;
+  }
+#endif
+  pack_at_most_scalar( src + done, dst + done/64, n - done, thresh );
+}
+
+/**
+ * @brief Fused color overlay of a registered Moving and Fixed row.
+ *
+ * Same bytes as colorizing the Moving pixels green ( m, 255, m ) and the
+ * Fixed pixels magenta ( 255, f, 255 ) and blending them with OpenCV
+ * addWeighted( 0.5, 0.5 ), in one pass without the 3-channel intermediates.
+ * The only vector variant is SSSE3, whose byte shuffle does the interleave:
+ * it runs at every level from SSE2 up if the CPU has SSSE3 (every AVX2 CPU
+ * does).  There is no AVX2 or AVX-512 variant.
+ *
+ * @param moving IN grayscale Moving pixels
+ * @param fixed IN grayscale Fixed pixels
+ * @param dst OUT 3n interleaved bytes
+ * @param n IN number of pixels
+ */
+void overlay_tint( const uint8_t *moving, const uint8_t *fixed, uint8_t *dst,
+                   const size_t n )
+{
+  size_t done{0};
+#if NFRL_SIMD_X86
+  static const bool ssse3 = has_ssse3();
+  if( ssse3 && simd_level() >= sse2 )
+    done = overlay_tint_ssse3( moving, fixed, dst, n );
+#endif
+  overlay_tint_scalar( moving + done, fixed + done, dst + 3*done, n - done );
+}
+
+/**
+ * @brief Palette index of the color overlay, 16 levels per image.
+ * ```
+ * index = ( moving & 0xF0 ) | ( fixed >> 4 )
+ * ```
+ *
+ * @param moving IN grayscale Moving pixels
+ * @param fixed IN grayscale Fixed pixels
+ * @param dst OUT palette indices
+ * @param n IN number of pixels
+ */
+void overlay_palette_index( const uint8_t *moving, const uint8_t *fixed,
+                            uint8_t *dst, const size_t n )
+{
+  size_t done{0};
+#if NFRL_SIMD_X86
+  if( simd_level() >= sse2 )
+    done = overlay_palette_index_sse2( moving, fixed, dst, n );
+#endif
+  overlay_palette_index_scalar( moving + done, fixed + done, dst + done,
+                                n - done );
+}
+
+/**
+ * @brief Resample one row of a warp with bilinear interpolation.
+ *
+ * Source coordinates are fixed point with WARP_COORD_BITS fractional bits:
+ * pixel i maps to ( X0 + adelta[i], Y0 + bdelta[i] ), so a row costs one add
+ * per coordinate.  The interpolation uses the top WARP_WEIGHT_BITS of the
+ * fraction and integer arithmetic only; neighbors outside the source are the
+ * border value.  The result depends only on the coordinates, never on the
+ * CPU, the row split or the thread.
+ *
+ * @param src IN source image
+ * @param adelta IN x-coordinate step of each pixel from the row start
+ * @param bdelta IN y-coordinate step of each pixel from the row start
+ * @param X0 IN x-coordinate of the row start, with the rounding delta
+ * @param Y0 IN y-coordinate of the row start, with the rounding delta
+ * @param dst OUT n pixels
+ * @param n IN number of pixels
+ */
+void warp_bilinear_row( const WarpSource &src, const int *adelta,
+                        const int *bdelta, const int X0, const int Y0,
+                        uint8_t *dst, const size_t n )
+{
+  size_t done{0};
+#if NFRL_SIMD_X86
+  if( simd_level() >= avx2 )
+    done = warp_bilinear_avx2( src, adelta, bdelta, X0, Y0, dst, n );
+#endif
+  warp_bilinear_scalar( src, adelta + done, bdelta + done, X0, Y0,
+                        dst + done, n - done );
+}
+
+/**
+ * @brief Resample one row of a warp with nearest-neighbor interpolation.
+ *
+ * Coordinates as warp_bilinear_row(); the rounding delta in X0 and Y0 makes
+ * the truncation round to the nearest pixel.  Scalar only: there is no
+ * vectorized variant at any level.
+ *
+ * @param src IN source image
+ * @param adelta IN x-coordinate step of each pixel from the row start
+ * @param bdelta IN y-coordinate step of each pixel from the row start
+ * @param X0 IN x-coordinate of the row start, with the rounding delta
+ * @param Y0 IN y-coordinate of the row start, with the rounding delta
+ * @param dst OUT n pixels
+ * @param n IN number of pixels
+ */
+void warp_nearest_row( const WarpSource &src, const int *adelta,
+                       const int *bdelta, const int X0, const int Y0,
+                       uint8_t *dst, const size_t n )
+{
+  warp_nearest_scalar( src, adelta, bdelta, X0, Y0, dst, n );
+}
+
+}   // END namespace
@@ -0,0 +1,358 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "strip_png_encoder.h"
+#include "exceptions.h"
+#include "task_graph.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace NFRL {
+
+namespace {
+
+/** @brief Bytes of history a deflate stream may refer back to. */
+const int DEFLATE_WINDOW = 32768;
+
+/** @brief Append a 32-bit, big-endian integer. */
+void append_u32( std::vector<uint8_t> &vec, const uint32_t v )
+{
+  const uint8_t b[4] = { static_cast<uint8_t>( v >> 24 ),
+                         static_cast<uint8_t>( v >> 16 ),
+                         static_cast<uint8_t>( v >> 8 ),
+                         static_cast<uint8_t>( v ) };
+  vec.insert( vec.end(), b, b + 4 );
+}
+
+/** @brief Append a PNG chunk: length, type, data and CRC. */
+void append_chunk( std::vector<uint8_t> &png, const char *type,
+                   const uint8_t *data, const size_t n )
+{
+  const auto *t = reinterpret_cast<const Bytef*>( type );
+  uLong crc = crc32( crc32( 0L, Z_NULL, 0 ), t, 4 );
+  if( n > 0 )
+    crc = crc32( crc, data, static_cast<uInt>( n ) );
+  append_u32( png, static_cast<uint32_t>( n ) );
+  png.insert( png.end(), type, type + 4 );
+  png.insert( png.end(), data, data + n );
+  append_u32( png, static_cast<uint32_t>( crc ) );
+}
+
+/** @brief Paeth predictor of the PNG specification. */
+inline uint8_t paeth( const int a, const int b, const int c )
+{
+  const int p = a + b - c;
+  const int pa = std::abs( p - a ), pb = std::abs( p - b ), pc = std::abs( p - c );
+  if( pa <= pb && pa <= pc )
+    return static_cast<uint8_t>( a );
+  return static_cast<uint8_t>( pb <= pc ? b : c );
+}
+
+/**
+ * @brief Filter one row: the filter type byte, then the filtered bytes.
+ *
+ * @param type IN PNG filter type, 0 to 4
+ * @param cur IN row samples
+ * @param prev IN samples of the row above, all zero for the first row
+ * @param n IN bytes of the row
+ * @param bpp IN bytes per pixel, at least 1
+ * @param out OUT n + 1 bytes
+ */
+void filter_row( const int type, const uint8_t *cur, const uint8_t *prev,
+                 const int n, const int bpp, uint8_t *out )
+{
+  out[0] = static_cast<uint8_t>( type );
+  uint8_t *dst = out + 1;
+  for( int i=0; i<n; i++ )
+  {
+    const int a = ( i >= bpp ) ? cur[i - bpp] : 0;
+    const int b = prev[i];
+    const int c = ( i >= bpp ) ? prev[i - bpp] : 0;
+    int pred;
+    switch( type )
+    {
+      case 1  : pred = a; break;
+      case 2  : pred = b; break;
+      case 3  : pred = ( a + b ) >> 1; break;
+      case 4  : pred = paeth( a, b, c ); break;
+      default : pred = 0; break;
+    }
+    dst[i] = static_cast<uint8_t>( cur[i] - pred );
+  }
+}
+
+/** @return sum of the filtered bytes as signed magnitudes, libpng's
+ *          heuristic of the best filter */
+long filtered_cost( const uint8_t *filtered, const int n )
+{
+  long sum{0};
+  for( int i=0; i<n; i++ )
+    sum += ( filtered[i] < 128 ) ? filtered[i] : 256 - filtered[i];
+  return sum;
+}
+
+/**
+ * @brief Samples of one image row in PNG order: packed bits of a bilevel
+ *  image (nonzero is 1, as libpng packs), RGB of a BGR image, else bytes.
+ */
+void png_samples( const cv::Mat &img, const int y, const bool bilevel,
+                  uint8_t *out )
+{
+  const uint8_t *src = img.ptr<uint8_t>(y);
+  const int w = img.cols;
+  if( bilevel )
+  {
+    std::memset( out, 0, ( w + 7 ) / 8 );
+    for( int x=0; x<w; x++ )
+    {
+      if( src[x] != 0 )
+        out[x >> 3] |= static_cast<uint8_t>( 0x80 >> ( x & 7 ) );
+    }
+  }
+  else if( img.channels() == 3 )
+  {
+    for( int x=0; x<w; x++, src += 3, out += 3 )
+    {
+      out[0] = src[2];
+      out[1] = src[1];
+      out[2] = src[0];
+    }
+  }
+  else
+  {
+    std::memcpy( out, src, w );
+  }
+}
+
+/** @brief One strip of rows: its filtered size, Adler-32, and IDAT data
+ *   and CRC. */
+struct Strip
+{
+  int firstRow{0};
+  int endRow{0};
+  size_t filteredBytes{0};
+  uLong adler{1};
+  std::vector<uint8_t> idat;
+  uLong crc{0};
+};
+
+}   // END anonymous namespace
+
+
+/**
+ * @param level IN zlib level, 0 (store) to 9 (smallest)
+ * @param strategy IN zlib strategy, e.g., Z_RLE
+ * @param filter IN PNG filter type of every row, 0 (none) to 4 (Paeth), or
+ *               ADAPTIVE_FILTER
+ * @param threads IN threads of an encode, 0 for all hardware threads
+ */
+StripPngEncoder::StripPngEncoder( const int level, const int strategy,
+                                  const int filter, const int threads )
+  : _level( std::max( 0, std::min( level, 9 ) ) ), _strategy( strategy ),
+    _filter( ( filter >= 0 && filter <= 4 ) ? filter : ADAPTIVE_FILTER ),
+    _threads( TaskGraph::threadBudget( threads ) )
+{
+}
+
+/**
+ * @brief Encode an 8-bit image as PNG.
+ *
+ * @param img IN 8-bit image: 1-channel (grayscale, bilevel, or palette
+ *            indices) or 3-channel BGR
+ * @param png OUT byte-stream
+ * @param bilevel IN encode a binary (0 or 255) image as a 1-bit PNG
+ * @param palette IN RGB triplets, at most 256; if not empty, img holds the
+ *                indices of a palette PNG
+ *
+ * @throw NFRL::Miscue unsupported image, or zlib cannot deflate a strip
+ */
+void StripPngEncoder::encode( const cv::Mat &img, std::vector<uint8_t> &png,
+                              const bool bilevel,
+                              const std::vector<uint8_t> &palette ) const
+{
+  const int channels = img.channels();
+  if( img.depth() != CV_8U || img.empty() ||
+      ( channels != 1 && channels != 3 ) ||
+      ( channels != 1 && ( bilevel || !palette.empty() ) ) ||
+      palette.size() % 3 != 0 || palette.size() > 768 )
+  {
+    throw NFRL::Miscue( "StripPngEncoder, unsupported image" );
+  }
+
+  const uint8_t bitDepth = bilevel ? 1 : 8;
+  const uint8_t colorType = !palette.empty() ? 3 : ( channels == 3 ? 2 : 0 );
+  const int rowBytes = bilevel ? ( img.cols + 7 ) / 8 : img.cols * channels;
+  const int bpp = bilevel ? 1 : channels;
+  const int filteredRow = rowBytes + 1;
+  const int stripRows = std::max( 1, STRIP_BYTES / rowBytes );
+  const int dictRows = ( DEFLATE_WINDOW + filteredRow - 1 ) / filteredRow;
+
+  std::vector<Strip> strips( ( img.rows + stripRows - 1 ) / stripRows );
+  TaskGraph graph;
+  for( size_t s=0; s<strips.size(); s++ )
+  {
+    Strip &strip = strips[s];
+    strip.firstRow = static_cast<int>( s ) * stripRows;
+    strip.endRow = std::min( img.rows, strip.firstRow + stripRows );
+    const bool first = ( s == 0 ), last = ( s + 1 == strips.size() );
+
+    graph.add( [&, first, last]()
+    {
+      // Filter the strip, and the rows before it that prime the dictionary.
+      const int y0 = std::max( 0, strip.firstRow - dictRows );
+      std::vector<uint8_t> filtered(
+        static_cast<size_t>( strip.endRow - y0 ) * filteredRow );
+      std::vector<uint8_t> prev( rowBytes, 0 ), cur( rowBytes );
+      std::vector<uint8_t> trial( _filter == ADAPTIVE_FILTER ? filteredRow : 0 );
+      if( y0 > 0 )
+        png_samples( img, y0 - 1, bilevel, prev.data() );
+      for( int y=y0; y<strip.endRow; y++ )
+      {
+        png_samples( img, y, bilevel, cur.data() );
+        uint8_t *out = &filtered[ static_cast<size_t>( y - y0 ) * filteredRow ];
+        if( _filter != ADAPTIVE_FILTER )
+        {
+          filter_row( _filter, cur.data(), prev.data(), rowBytes, bpp, out );
+        }
+        else
+        {
+          long best{-1};
+          for( int type=0; type<=4; type++ )
+          {
+            filter_row( type, cur.data(), prev.data(), rowBytes, bpp,
+                        trial.data() );
+            const long cost = filtered_cost( trial.data() + 1, rowBytes );
+            if( best < 0 || cost < best )
+            {
+              best = cost;
+              std::memcpy( out, trial.data(), filteredRow );
+            }
+          }
+        }
+        prev.swap( cur );
+      }
+
+      const size_t dictBytes =
+        std::min<size_t>( static_cast<size_t>( strip.firstRow - y0 ) * filteredRow,
+                          DEFLATE_WINDOW );
+      const uint8_t *data = filtered.data() + filtered.size() -
+        static_cast<size_t>( strip.endRow - strip.firstRow ) * filteredRow;
+      strip.filteredBytes = filtered.data() + filtered.size() - data;
+      strip.adler = adler32( adler32( 0L, Z_NULL, 0 ), data,
+                             static_cast<uInt>( strip.filteredBytes ) );
+
+      z_stream zs;
+      std::memset( &zs, 0, sizeof( zs ) );
+      if( deflateInit2( &zs, _level, Z_DEFLATED, -15, 8, _strategy ) != Z_OK )
+        throw NFRL::Miscue( "StripPngEncoder, zlib cannot deflate" );
+      if( dictBytes > 0 )
+        deflateSetDictionary( &zs, data - dictBytes, static_cast<uInt>( dictBytes ) );
+
+      // A zlib header leads the first strip; the Adler-32 of the whole
+      // stream trails the last, appended once all strips are done.
+      const size_t head = first ? 2 : 0;
+      strip.idat.resize( head + deflateBound( &zs, strip.filteredBytes ) + 64 );
+      if( first )
+      {
+        const int flevel = ( _level <= 1 ) ? 0 : ( _level <= 5 ) ? 1 :
+                           ( _level == 6 ) ? 2 : 3;
+        const int cmf = 0x78;
+        int flg = flevel << 6;
+        flg += 31 - ( cmf * 256 + flg ) % 31;
+        strip.idat[0] = static_cast<uint8_t>( cmf );
+        strip.idat[1] = static_cast<uint8_t>( flg );
+      }
+      zs.next_in = const_cast<Bytef*>( data );
+      zs.avail_in = static_cast<uInt>( strip.filteredBytes );
+      const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+      int rc;
+      do {
+        if( zs.total_out + head == strip.idat.size() )
+          strip.idat.resize( strip.idat.size() * 2 );
+        zs.next_out = strip.idat.data() + head + zs.total_out;
+        zs.avail_out = static_cast<uInt>( strip.idat.size() - head - zs.total_out );
+        rc = deflate( &zs, flush );
+      } while( rc == Z_OK && ( zs.avail_out == 0 || ( last && rc != Z_STREAM_END ) ) );
+      const size_t written = head + zs.total_out;
+      deflateEnd( &zs );
+      if( rc != ( last ? Z_STREAM_END : Z_OK ) )
+        throw NFRL::Miscue( "StripPngEncoder, zlib cannot deflate" );
+      strip.idat.resize( written );
+      strip.crc = crc32( crc32( crc32( 0L, Z_NULL, 0 ),
+                                reinterpret_cast<const Bytef*>( "IDAT" ), 4 ),
+                         strip.idat.data(), static_cast<uInt>( written ) );
+    } );
+  }
+  graph.run( _threads );
+
+  // Combine the Adler-32 of the strips; the last chunk's CRC is extended
+  // over the trailer without reading its data again.
+  uLong adler = strips[0].adler;
+  for( size_t s=1; s<strips.size(); s++ )
+  {
+    adler = adler32_combine( adler, strips[s].adler,
+                             static_cast<z_off_t>( strips[s].filteredBytes ) );
+  }
+  uint8_t trailer[4] = { static_cast<uint8_t>( adler >> 24 ),
+                         static_cast<uint8_t>( adler >> 16 ),
+                         static_cast<uint8_t>( adler >> 8 ),
+                         static_cast<uint8_t>( adler ) };
+  Strip &tail = strips.back();
+  tail.crc = crc32_combine( tail.crc, crc32( crc32( 0L, Z_NULL, 0 ), trailer, 4 ), 4 );
+  tail.idat.insert( tail.idat.end(), trailer, trailer + 4 );
+
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  size_t total = sizeof( signature ) + 25 + 12 + palette.size() + 12;
+  for( const Strip &strip : strips )
+    total += strip.idat.size() + 12;
+  png.clear();
+  png.reserve( total );
+  png.insert( png.end(), signature, signature + sizeof( signature ) );
+
+  std::vector<uint8_t> header;
+  append_u32( header, static_cast<uint32_t>( img.cols ) );
+  append_u32( header, static_cast<uint32_t>( img.rows ) );
+  header.insert( header.end(), { bitDepth, colorType, 0, 0, 0 } );
+  append_chunk( png, "IHDR", header.data(), header.size() );
+  if( !palette.empty() )
+    append_chunk( png, "PLTE", palette.data(), palette.size() );
+  for( const Strip &strip : strips )
+  {
+    append_u32( png, static_cast<uint32_t>( strip.idat.size() ) );
+    png.insert( png.end(), { 'I', 'D', 'A', 'T' } );
+    png.insert( png.end(), strip.idat.begin(), strip.idat.end() );
+    append_u32( png, static_cast<uint32_t>( strip.crc ) );
+  }
+  append_chunk( png, "IEND", nullptr, 0 );
+}
+
+}   // End namespace
@@ -0,0 +1,195 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "task_graph.h"
+#include "exceptions.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace NFRL {
+
+/** @brief Initialization function that resets all values. */
+void TaskGraph::Init()
+{
+  _tasks.clear();
+  _dependencies.clear();
+  _threadsUsed = 0;
+}
+
+/** @brief Default constructor.  Calls Init(). */
+TaskGraph::TaskGraph()
+{
+  Init();
+}
+
+/**
+ * @param task IN work of the task
+ * @param dependencies IN tasks that must complete first, already added
+ *
+ * @return id of the task, in the order added
+ * @throw NFRL::Miscue dependency not added yet
+ */
+int TaskGraph::add( Task task, const std::vector<int> &dependencies )
+{
+  const int id = size();
+  for( const int dep : dependencies )
+  {
+    if( dep < 0 || dep >= id )
+      throw NFRL::Miscue( "TaskGraph, dependency must be added before its task" );
+  }
+  _tasks.push_back( std::move( task ) );
+  _dependencies.push_back( dependencies );
+  return id;
+}
+
+/**
+ * @param threads IN requested threads, 0 or less for all hardware threads
+ *
+ * @return threads to use, at least 1
+ */
+int TaskGraph::threadBudget( const int threads )
+{
+  if( threads > 0 )
+    return threads;
+  return std::max( 1, static_cast<int>( std::thread::hardware_concurrency() ) );
+}
+
+/**
+ * @brief Run every task, each after its dependencies.
+ *
+ * @param threads IN thread budget, the calling thread included; 1 runs the
+ *                tasks in the order added on the calling thread, 0 uses all
+ *                hardware threads
+ *
+ * @throw exception of the first failed task, in the order added
+ */
+void TaskGraph::run( const int threads )
+{
+  const int workers = std::min( threadBudget( threads ), size() );
+  _threadsUsed = std::max( workers, 1 );
+  std::vector<std::exception_ptr> errors( size() );
+  if( workers <= 1 )
+    runSerial( errors );
+  else
+    runParallel( workers, errors );
+
+  for( const std::exception_ptr &error : errors )
+  {
+    if( error )
+      std::rethrow_exception( error );
+  }
+}
+
+/** @brief Run the tasks in the order added; the first exception stops. */
+void TaskGraph::runSerial( std::vector<std::exception_ptr> &errors )
+{
+  for( int id=0; id<size(); id++ )
+  {
+    try {
+      _tasks[id]();
+    }
+    catch( ... ) {
+      errors[id] = std::current_exception();
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Run the tasks on worker threads, lowest ready id first.
+ *
+ * @param workers IN threads, the calling thread included
+ * @param errors OUT exception of each failed task
+ */
+void TaskGraph::runParallel( const int workers,
+                             std::vector<std::exception_ptr> &errors )
+{
+  const int n = size();
+  std::vector<int> pending( n );
+  std::vector<std::vector<int>> dependents( n );
+  std::set<int> ready;
+  for( int id=0; id<n; id++ )
+  {
+    pending[id] = static_cast<int>( _dependencies[id].size() );
+    for( const int dep : _dependencies[id] )
+      dependents[dep].push_back( id );
+    if( pending[id] == 0 )
+      ready.insert( id );
+  }
+  std::vector<char> skipped( n, 0 );
+  int remaining{n};
+  std::mutex mtx;
+  std::condition_variable changed;
+
+  auto worker = [&]()
+  {
+    std::unique_lock<std::mutex> lock( mtx );
+    while( true )
+    {
+      changed.wait( lock, [&]{ return !ready.empty() || remaining == 0; } );
+      if( ready.empty() )
+        return;
+      const int id = *ready.begin();
+      ready.erase( ready.begin() );
+      bool failed = skipped[id] != 0;
+      if( !failed )
+      {
+        lock.unlock();
+        try {
+          _tasks[id]();
+        }
+        catch( ... ) {
+          errors[id] = std::current_exception();
+          failed = true;
+        }
+        lock.lock();
+      }
+      remaining--;
+      for( const int next : dependents[id] )
+      {
+        if( failed )
+          skipped[next] = 1;
+        if( --pending[next] == 0 )
+          ready.insert( next );
+      }
+      changed.notify_all();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for( int i=1; i<workers; i++ )
+    pool.emplace_back( worker );
+  worker();
+  for( std::thread &t : pool )
+    t.join();
+}
+
+}   // End namespace
@@ -0,0 +1,314 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "tiled_engine.h"
+#include "opencv_procs.h"
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace NFRL {
+
+namespace {
+
+/** @return number of tiles of size n covering length */
+int tiles_across( const int length, const int n )
+{
+  return ( length + n - 1 ) / n;
+}
+
+}   // END anonymous namespace
+
+
+/** @brief Initialization function that resets all values. */
+void TiledEngine::Init()
+{
+  _tileCount = 0;
+  _transformClass = CVops::generalTransform;
+  _canvasSize = cv::Size( 0, 0 );
+  _registeredMoving = VirtualPaddedImage();
+  _movingThresh = 0;
+  _fixedThresh = 0;
+  _overlay = cv::Mat();
+  _overlapRect = cv::Rect();
+  _overlap = BinaryImage();
+  _overlapBox = cv::Rect();
+}
+
+/** @brief Default constructor.  Calls Init(). */
+TiledEngine::TiledEngine()
+{
+  Init();
+}
+
+/**
+ * @param tileSize IN tile width and height in pixels, at least 64
+ * @param fixedPointWarp IN warp with NFRL's fixed-point resampler
+ */
+TiledEngine::TiledEngine( const int tileSize, const bool fixedPointWarp )
+  : _tileSize( std::max( tileSize, 64 ) ), _fixedPointWarp( fixedPointWarp )
+{
+  Init();
+}
+
+/**
+ * @brief Register the Moving image onto the Fixed canvas and overlap the
+ *  binarized images.
+ *
+ * @param moving IN Moving image placed on the canvas
+ * @param transform IN 2x3 canvas-to-canvas transform of the Moving image
+ * @param interpolation IN cv::InterpolationFlags
+ * @param supportMargin IN pixels past the source edges that interpolation
+ *                      can reach
+ * @param fixed IN padded Fixed image, same canvas size
+ * @param renderOverlay IN also render the color overlay
+ *
+ * @throw NFRL::Miscue OpenCV cannot warp or overlap the images
+ */
+void TiledEngine::run( const VirtualPaddedImage &moving,
+                       const cv::Mat &transform,
+                       const int &interpolation,
+                       const int &supportMargin,
+                       const VirtualPaddedImage &fixed,
+                       const bool renderOverlay )
+{
+  Init();
+  _canvasSize = fixed.size();
+  try {
+    warpAndHistogram( moving, transform, interpolation, supportMargin,
+                      fixed, renderOverlay );
+    binarizeAndOverlap( fixed );
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"TiledEngine, cannot register images: "};
+    err.append( ex.what() );
+    throw NFRL::Miscue( err );
+  }
+}
+
+/**
+ * @brief Pass 1: warp each tile of the Moving footprint, histogram both
+ *  images and render the overlay of each tile while it is in cache.
+ *
+ * The tiles cover the union of the footprint and the Fixed image; the rest
+ * of the canvas is padding in both images.  The padding is counted, not
+ * read, for the Otsu thresholds.
+ */
+void TiledEngine::warpAndHistogram( const VirtualPaddedImage &moving,
+                                    const cv::Mat &transform,
+                                    const int &interpolation,
+                                    const int &supportMargin,
+                                    const VirtualPaddedImage &fixed,
+                                    const bool renderOverlay )
+{
+  cv::Rect footprint;
+  const cv::Mat m = CVops::footprint_warp_matrix( moving, transform,
+                                                  supportMargin, footprint );
+  // Transforms that need no resample only place the source (see
+  // CVops::classify_transform()); the tiles then only read it.
+  int rotateCode;
+  cv::Point offset;
+  _transformClass = CVops::classify_transform( m, moving.source().size(),
+                                               rotateCode, offset );
+  const bool resample = !footprint.empty() &&
+                        _transformClass == CVops::generalTransform;
+  cv::Mat warped;
+  if( resample )
+  {
+    warped.create( footprint.size(), CV_8UC1 );
+    _registeredMoving = VirtualPaddedImage( warped, footprint.tl(),
+                                            _canvasSize, moving.borderValue() );
+  }
+  else if( footprint.empty() )
+  {
+    _registeredMoving = VirtualPaddedImage( cv::Mat(), cv::Point( 0, 0 ),
+                                            _canvasSize, moving.borderValue() );
+  }
+  else
+  {
+    _registeredMoving = CVops::place_footprint( moving, footprint, rotateCode,
+                                                offset );
+  }
+  const cv::Rect stored = _registeredMoving.sourceRect();
+
+  if( renderOverlay )
+  {
+    uint8_t border[3];
+    const uint8_t bm = moving.borderValue(), bf = fixed.borderValue();
+    Kernels::overlay_tint( &bm, &bf, border, 1 );
+    _overlay = cv::Mat( _canvasSize, CV_8UC3,
+                        cv::Scalar( border[0], border[1], border[2] ) );
+  }
+
+  const cv::Rect fixedRect = fixed.sourceRect();
+  const cv::Rect area = stored | fixedRect;
+  const int nx = tiles_across( area.width, _tileSize );
+  const int ny = tiles_across( area.height, _tileSize );
+  std::vector<CVops::Histogram> movingHists( nx * ny ), fixedHists( nx * ny );
+  const VirtualPaddedImage &registered = _registeredMoving;
+
+  cv::parallel_for_( cv::Range( 0, nx * ny ), [&]( const cv::Range &range )
+  {
+    std::vector<uint8_t> scratchM( _tileSize ), scratchF( _tileSize );
+    for( int t=range.start; t<range.end; t++ )
+    {
+      const cv::Rect tile = cv::Rect( area.x + ( t % nx ) * _tileSize,
+                                      area.y + ( t / nx ) * _tileSize,
+                                      _tileSize, _tileSize ) & area;
+
+      const cv::Rect movingPart = tile & stored;
+      if( !movingPart.empty() )
+      {
+        const cv::Rect local = movingPart - stored.tl();
+        cv::Mat dst = registered.source()( local );
+        if( resample && _fixedPointWarp )
+          CVops::warp_rigid_region( moving.source(), m, local, interpolation,
+                                    moving.borderValue(), dst );
+        else if( resample )
+          CVops::warp_affine_region( moving.source(), m, local, interpolation,
+                                     moving.borderValue(), dst );
+        movingHists[t] = CVops::image_histogram( dst );
+      }
+
+      const cv::Rect fixedPart = tile & fixedRect;
+      if( !fixedPart.empty() )
+      {
+        fixedHists[t] = CVops::image_histogram(
+                          fixed.source()( fixedPart - fixedRect.tl() ) );
+      }
+
+      if( renderOverlay )
+      {
+        for( int y=tile.y; y<tile.y + tile.height; y++ )
+        {
+          Kernels::overlay_tint(
+            registered.rowSpan( y, tile.x, tile.width, scratchM.data() ),
+            fixed.rowSpan( y, tile.x, tile.width, scratchF.data() ),
+            _overlay.ptr<uint8_t>(y) + 3 * tile.x, tile.width );
+        }
+      }
+    }
+  } );
+  _tileCount += nx * ny;
+
+  CVops::Histogram movingHist{}, fixedHist{};
+  for( int t=0; t<nx * ny; t++ )
+  {
+    for( int i=0; i<256; i++ )
+    {
+      movingHist[i] += movingHists[t][i];
+      fixedHist[i] += fixedHists[t][i];
+    }
+  }
+  _movingThresh = static_cast<int>( CVops::otsu_threshold(
+    movingHist, _registeredMoving.paddingCount(), moving.borderValue() ) );
+  _fixedThresh = static_cast<int>( CVops::otsu_threshold(
+    fixedHist, fixed.paddingCount(), fixed.borderValue() ) );
+}
+
+/**
+ * @brief Pass 2: binarize and AND both images straight to bits, and reduce
+ *  the bounding box of each tile.
+ *
+ * As OverlapRegisteredImages, only the region where both binaries may be
+ * black is computed.  Tile widths are whole words, so each tile writes its
+ * own words of the overlap rows.
+ */
+void TiledEngine::binarizeAndOverlap( const VirtualPaddedImage &fixed )
+{
+  const cv::Rect canvas( cv::Point( 0, 0 ), _canvasSize );
+  const cv::Rect region1 = ( _registeredMoving.borderValue() <= _movingThresh )
+                           ? canvas : _registeredMoving.sourceRect();
+  const cv::Rect region2 = ( fixed.borderValue() <= _fixedThresh )
+                           ? canvas : fixed.sourceRect();
+  _overlapRect = region1 & region2;
+  if( _overlapRect.empty() )
+    return;
+  _overlap = BinaryImage( _overlapRect.size() );
+
+  const int tileWidth = ( ( _tileSize + 63 ) / 64 ) * 64;
+  const int nx = tiles_across( _overlapRect.width, tileWidth );
+  const int ny = tiles_across( _overlapRect.height, _tileSize );
+  std::vector<cv::Rect> boxes( nx * ny );
+
+  cv::parallel_for_( cv::Range( 0, nx * ny ), [&]( const cv::Range &range )
+  {
+    std::vector<uint8_t> scratch( tileWidth );
+    std::vector<uint64_t> fixedBits( tileWidth / 64 );
+    for( int t=range.start; t<range.end; t++ )
+    {
+      const cv::Rect tile = cv::Rect( ( t % nx ) * tileWidth,
+                                      ( t / nx ) * _tileSize,
+                                      tileWidth, _tileSize ) &
+                            cv::Rect( cv::Point( 0, 0 ), _overlapRect.size() );
+      const int x = _overlapRect.x + tile.x;
+      for( int y=tile.y; y<tile.y + tile.height; y++ )
+      {
+        uint64_t *bits = _overlap.row(y) + tile.x / 64;
+        Kernels::pack_at_most(
+          _registeredMoving.rowSpan( _overlapRect.y + y, x, tile.width,
+                                     scratch.data() ),
+          bits, tile.width, _movingThresh );
+        Kernels::pack_at_most(
+          fixed.rowSpan( _overlapRect.y + y, x, tile.width, scratch.data() ),
+          fixedBits.data(), tile.width, _fixedThresh );
+        for( int w=0; w<( tile.width + 63 ) / 64; w++ )
+          bits[w] &= fixedBits[w];
+      }
+      boxes[t] = _overlap.boundingRect( tile );
+    }
+  } );
+  _tileCount += nx * ny;
+
+  for( const cv::Rect &box : boxes )
+  {
+    if( box.empty() )
+      continue;
+    _overlapBox = _overlapBox.empty() ? box : ( _overlapBox | box );
+  }
+}
+
+/**
+ * @return tile size, tile count, transform class and thresholds in print
+ *         format
+ */
+std::string TiledEngine::to_s() const
+{
+  std::string s{"TiledEngine:\n"};
+  s += " * Tile size: " + std::to_string( _tileSize ) + "\n";
+  s += " * Tiles: " + std::to_string( _tileCount ) + "\n";
+  s += std::string( " * Warp: " ) +
+       ( _fixedPointWarp ? "NFRL fixed-point" : "OpenCV" ) + "\n";
+  s += std::string( " * Transform class: " ) +
+       CVops::transform_class_name( _transformClass ) + "\n";
+  s += " * Otsu thresholds, Moving: " + std::to_string( _movingThresh ) +
+       ", Fixed: " + std::to_string( _fixedThresh ) + "\n";
+  return s;
+}
+
+}   // End namespace
@@ -0,0 +1,178 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "virtual_padded_image.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace NFRL {
+
+/** @brief Initialization function that resets all values. */
+void VirtualPaddedImage::Init()
+{
+  _source = cv::Mat();
+  _offset = cv::Point( 0, 0 );
+  _canvasSize = cv::Size( 0, 0 );
+  _borderValue = 255;
+}
+
+/** @brief Default constructor.  Calls Init(). */
+VirtualPaddedImage::VirtualPaddedImage()
+{
+  Init();
+}
+
+/**
+ * @brief The source pixels are shared, not copied.
+ *
+ * Any part of the source that falls outside the canvas is dropped.
+ *
+ * @param source IN 8-bit, single-channel pixels
+ * @param offset IN location of the top-left source pixel within the canvas
+ * @param canvasSize IN width and height of the padded canvas
+ * @param borderValue IN value of every canvas pixel outside the source
+ */
+VirtualPaddedImage::VirtualPaddedImage( const cv::Mat &source,
+                                        const cv::Point &offset,
+                                        const cv::Size &canvasSize,
+                                        const uint8_t borderValue )
+  : _offset(offset), _canvasSize(canvasSize), _borderValue(borderValue)
+{
+  cv::Rect placed( offset, source.size() );
+  cv::Rect clipped = placed & cv::Rect( cv::Point( 0, 0 ), canvasSize );
+  if( clipped.empty() )
+  {
+    _offset = cv::Point( 0, 0 );
+    return;
+  }
+  _source = source( clipped - offset );
+  _offset = clipped.tl();
+}
+
+/**
+ * @return rectangle of the stored pixels in canvas coordinates
+ */
+cv::Rect VirtualPaddedImage::sourceRect() const
+{
+  return cv::Rect( _offset, _source.size() );
+}
+
+/**
+ * @return number of canvas pixels that are border (not stored)
+ */
+size_t VirtualPaddedImage::paddingCount() const
+{
+  return static_cast<size_t>( _canvasSize.area() ) - _source.total();
+}
+
+/**
+ * @brief Pixel value at canvas coordinates.
+ *
+ * @param row IN canvas row
+ * @param col IN canvas column
+ *
+ * @return stored pixel, or the border value outside the stored pixels
+ */
+uint8_t VirtualPaddedImage::at( int row, int col ) const
+{
+  int r = row - _offset.y;
+  int c = col - _offset.x;
+  if( r < 0 || c < 0 || r >= _source.rows || c >= _source.cols )
+    return _borderValue;
+  return _source.at<uint8_t>( r, c );
+}
+
+/**
+ * @brief Run of pixels of a canvas row, without materializing the row.
+ *
+ * @param row IN canvas row
+ * @param col IN canvas column of the first pixel
+ * @param n IN number of pixels
+ * @param scratch IN/OUT n bytes, written if the run is not all stored pixels
+ *
+ * @return the stored pixels if the run is within them, otherwise scratch
+ */
+const uint8_t* VirtualPaddedImage::rowSpan( int row, int col, int n,
+                                            uint8_t *scratch ) const
+{
+  const int r = row - _offset.y;
+  const int c = col - _offset.x;
+  if( r >= 0 && r < _source.rows && c >= 0 && c + n <= _source.cols )
+    return _source.ptr<uint8_t>( r ) + c;
+
+  std::memset( scratch, _borderValue, n );
+  if( r < 0 || r >= _source.rows )
+    return scratch;
+  const int first = std::max( c, 0 );
+  const int last = std::min( c + n, _source.cols );
+  if( first < last )
+    std::memcpy( scratch + ( first - c ), _source.ptr<uint8_t>( r ) + first,
+                 last - first );
+  return scratch;
+}
+
+/**
+ * @brief Allocate the full, padded canvas.
+ *
+ * @return padded image
+ */
+cv::Mat VirtualPaddedImage::materialize() const
+{
+  return materialize( cv::Rect( cv::Point( 0, 0 ), _canvasSize ) );
+}
+
+/**
+ * @brief Region of the padded canvas.
+ *
+ * If the region lies within the stored pixels, the returned image shares
+ * them (no copy).  Otherwise the region is allocated, filled with the border
+ * value, and the overlapping stored pixels are copied in.
+ *
+ * @param region IN rectangle in canvas coordinates
+ *
+ * @return image the size of the region
+ */
+cv::Mat VirtualPaddedImage::materialize( const cv::Rect &region ) const
+{
+  cv::Rect stored = sourceRect();
+  cv::Rect common = stored & region;
+  if( common == region && !region.empty() )
+  {
+    return _source( region - _offset );
+  }
+
+  cv::Mat out( region.size(), CV_8UC1, cv::Scalar::all( _borderValue ) );
+  if( !common.empty() )
+  {
+    cv::Mat dst = out( common - region.tl() );
+    _source( common - _offset ).copyTo( dst );
+  }
+  return out;
+}
+
+}   // End namespace